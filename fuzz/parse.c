@@ -0,0 +1,179 @@
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "irc/irc.h"
+
+// Fuzz irc_parse and irc_classify. Built with libFuzzer when using clang, otherwise with a small random
+// mutator (FUZZ_STANDALONE). Either way the harness is built with address and undefined behavior sanitizers.
+// Usage: parse [-runs=<count>] <seed directory>
+
+// Abort if a parsed field does not point into the line, or is not terminated within it
+static void fuzz_checkField(const char *field, const char *line, size_t size) {
+  if (field == 0)
+    return;
+  if (field < line || field > line + size || memchr(field, 0, line + size + 1 - field) == 0)
+    abort();
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size >= IRC_MESSAGE_MAX_SIZE)
+    return 0;
+
+  // Lines are null-terminated like the ones returned by irc_readLine
+  char *line = malloc(size + 1);
+  memcpy(line, data, size);
+  line[size] = 0;
+
+  irc_classification_t classification;
+  irc_classify(line, &classification);
+  if (classification.priority == IRC_PRIORITY_LOW) {
+    fuzz_checkField(classification.sender, line, size);
+    fuzz_checkField(classification.target, line, size);
+    if (classification.target + classification.targetLength > line + size)
+      abort();
+  }
+
+  irc_message_t message;
+  if (irc_parse(line, &message)) {
+    fuzz_checkField(message.sender, line, size);
+    fuzz_checkField(message.user, line, size);
+    fuzz_checkField(message.host, line, size);
+    fuzz_checkField(message.type, line, size);
+    if (message.parameterCount > IRC_MAX_PARAMETERS || message.tagCount > IRC_MAX_TAGS)
+      abort();
+    for (size_t i = 0; i < message.parameterCount; i++)
+      fuzz_checkField(message.parameters[i], line, size);
+    for (size_t i = 0; i < message.tagCount; i++) {
+      fuzz_checkField(message.tags[i].key, line, size);
+      // Valueless tags point to a static empty string
+      if (message.tags[i].value[0] != 0)
+        fuzz_checkField(message.tags[i].value, line, size);
+      if (irc_getTag(&message, message.tags[i].key) == 0)
+        abort();
+    }
+
+    // A line classified as a PRIVMSG must parse as one
+    if (classification.priority == IRC_PRIORITY_LOW && strcmp(message.type, "PRIVMSG") != 0)
+      abort();
+  }
+
+  free(line);
+  return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+#define FUZZ_MAX_SEEDS 8192
+#define FUZZ_DEFAULT_RUNS 1000000
+
+// Bytes which are meaningful to the parser
+static const char fuzz_interesting[] = {' ', ':', '@', ';', '=', '!', '\\', '\r', '\n', 0, 'a', '0'};
+
+// Randomly mutate an input in place, returns the new size
+static size_t fuzz_mutate(uint8_t *data, size_t size, size_t maxSize, uint8_t **seeds, size_t *seedSizes, size_t seedCount) {
+  size_t mutations = 1 + rand() % 4;
+  for (size_t i = 0; i < mutations; i++) {
+    size_t position = size == 0 ? 0 : rand() % size;
+    switch (rand() % 6) {
+    case 0:
+      // Flip a bit
+      if (size > 0)
+        data[position] ^= 1 << (rand() % 8);
+      break;
+    case 1:
+      // Replace a byte with one the parser cares about
+      if (size > 0)
+        data[position] = fuzz_interesting[rand() % sizeof(fuzz_interesting)];
+      break;
+    case 2:
+      // Insert a byte
+      if (size < maxSize) {
+        memmove(data + position + 1, data + position, size - position);
+        data[position] = rand() % 2 ? fuzz_interesting[rand() % sizeof(fuzz_interesting)] : rand();
+        size++;
+      }
+      break;
+    case 3:
+      // Remove a range
+      if (size > 0) {
+        size_t length = 1 + rand() % (size - position);
+        memmove(data + position, data + position + length, size - position - length);
+        size -= length;
+      }
+      break;
+    case 4:
+      // Truncate
+      size = position;
+      break;
+    case 5: {
+      // Splice in part of another seed
+      size_t seed = rand() % seedCount;
+      size_t length = seedSizes[seed] == 0 ? 0 : rand() % seedSizes[seed];
+      if (size + length > maxSize)
+        length = maxSize - size;
+      memmove(data + position + length, data + position, size - position);
+      memcpy(data + position, seeds[seed], length);
+      size += length;
+      break;
+    }
+    }
+  }
+
+  return size;
+}
+
+int main(int argc, char **argv) {
+  size_t runs = FUZZ_DEFAULT_RUNS;
+  const char *seedDirectory = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "-runs=", 6) == 0)
+      runs = strtoull(argv[i] + 6, 0, 10);
+    else
+      seedDirectory = argv[i];
+  }
+
+  // Every file in the seed directory is one input
+  static uint8_t *seeds[FUZZ_MAX_SEEDS];
+  static size_t seedSizes[FUZZ_MAX_SEEDS];
+  size_t seedCount = 0;
+  DIR *directory = seedDirectory == 0 ? 0 : opendir(seedDirectory);
+  if (directory != 0) {
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != 0 && seedCount < FUZZ_MAX_SEEDS) {
+      char path[4096];
+      snprintf(path, sizeof(path), "%s/%s", seedDirectory, entry->d_name);
+      FILE *file = fopen(path, "rb");
+      if (file == 0)
+        continue;
+      seeds[seedCount] = malloc(IRC_MESSAGE_MAX_SIZE);
+      seedSizes[seedCount] = fread(seeds[seedCount], 1, IRC_MESSAGE_MAX_SIZE - 1, file);
+      fclose(file);
+      seedCount++;
+    }
+    closedir(directory);
+  }
+  if (seedCount == 0) {
+    seeds[0] = malloc(IRC_MESSAGE_MAX_SIZE);
+    seedSizes[0] = 0;
+    seedCount = 1;
+  }
+
+  srand(1);
+  uint8_t input[IRC_MESSAGE_MAX_SIZE];
+  for (size_t i = 0; i < seedCount; i++)
+    LLVMFuzzerTestOneInput(seeds[i], seedSizes[i]);
+  for (size_t run = 0; run < runs; run++) {
+    size_t seed = rand() % seedCount;
+    memcpy(input, seeds[seed], seedSizes[seed]);
+    size_t size = fuzz_mutate(input, seedSizes[seed], IRC_MESSAGE_MAX_SIZE - 1, seeds, seedSizes, seedCount);
+    LLVMFuzzerTestOneInput(input, size);
+  }
+
+  printf("parse: %zu seeds, %zu runs without failures\n", seedCount, runs);
+  for (size_t i = 0; i < seedCount; i++)
+    free(seeds[i]);
+  return 0;
+}
+#endif
@@ -0,0 +1,15 @@
+#!/usr/bin/env bash
+
+# Print the number of milliseconds it takes a build to replay a corpus a number of times
+# Usage: benchmark.sh <binary> <corpus> <iterations>
+binary="$1"
+corpus="$2"
+iterations="$3"
+
+start="$(date +%s%N)"
+for _ in $(seq "$iterations"); do
+  LOGGING_LEVEL=error "$binary" --replay "$corpus" || exit 1
+done
+end="$(date +%s%N)"
+
+echo $(((end - start) / 1000000))
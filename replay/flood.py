@@ -0,0 +1,90 @@
+#!/usr/bin/env python3
+
+# Flood a build with the PRIVMSGs of a corpus at a fixed rate while sending PINGs, and print
+# how quickly the PINGs are answered and how much load the bot shed
+# Usage: flood.py <binary> <corpus> <lines per second> [seconds]
+import os
+import socket
+import ssl
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+binary, corpus, rate = sys.argv[1], sys.argv[2], int(sys.argv[3])
+duration = float(sys.argv[4]) if len(sys.argv) > 4 else 10
+lines = [line for line in open(corpus, "rb").read().split(b"\n") if b" PRIVMSG " in line]
+
+# The bot does not verify certificates, so a throwaway self-signed one will do
+directory = tempfile.mkdtemp()
+certificate, key = os.path.join(directory, "cert.pem"), os.path.join(directory, "key.pem")
+subprocess.run(["openssl", "req", "-x509", "-newkey", "rsa:2048", "-nodes", "-subj", "/CN=localhost", "-keyout", key, "-out", certificate, "-days", "1"], check=True, capture_output=True)
+context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+context.load_cert_chain(certificate, key)
+
+server = socket.socket()
+server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+server.bind(("127.0.0.1", 0))
+server.listen(1)
+
+environment = dict(os.environ, IRC_SERVER="127.0.0.1", IRC_PORT=str(server.getsockname()[1]), IRC_CHANNEL="#flood", LOGGING_LEVEL="error")
+bot = subprocess.Popen([binary], env=environment)
+connection = context.wrap_socket(server.accept()[0], server_side=True)
+
+pings = {}
+latencies = []
+replies = []
+
+
+def receive():
+    buffer = b""
+    while True:
+        try:
+            data = connection.recv(65536)
+        except (OSError, ssl.SSLError):
+            return
+        if not data:
+            return
+        buffer += data
+        *received, buffer = buffer.split(b"\n")
+        for line in received:
+            if line.startswith(b"PONG :flood-") and line.strip() in pings:
+                latencies.append(time.monotonic() - pings.pop(line.strip()))
+            elif b"messages queued" in line:
+                replies.append(line.decode(errors="replace").split(" :", 1)[1].strip())
+
+
+receiver = threading.Thread(target=receive, daemon=True)
+receiver.start()
+
+sent = 0
+start = time.monotonic()
+next_ping = start
+while time.monotonic() - start < duration:
+    now = time.monotonic()
+    if now >= next_ping:
+        token = b"flood-%f" % now
+        pings[b"PONG :" + token] = now
+        connection.sendall(b"PING :" + token + b"\r\n")
+        next_ping = now + 0.25
+    # Send in batches every 10 ms to keep up the rate
+    batch = b"".join(lines[(sent + i) % len(lines)] + b"\r\n" for i in range(max(rate // 100, 1)))
+    connection.sendall(batch)
+    sent += max(rate // 100, 1)
+    time.sleep(max(0, start + sent / rate - time.monotonic()))
+
+time.sleep(1)
+connection.sendall(b":flood!f@h PRIVMSG #flood :watchlist-bot: load\r\n")
+time.sleep(1)
+bot.terminate()
+bot.wait()
+
+latencies.sort()
+print("Sent %d lines in %.1fs (%d lines per second)" % (sent, duration, sent / duration))
+if latencies:
+    print("Answered %d of %d PINGs, median %.1fms, max %.1fms" % (len(latencies), len(latencies) + len(pings), latencies[len(latencies) // 2] * 1000, latencies[-1] * 1000))
+else:
+    print("Answered none of %d PINGs" % len(pings))
+for reply in replies:
+    print(reply)
@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "irc/irc.h"
+
+#include "replay.h"
+
+// Measure how many lines per second irc_classify and irc_parse handle
+// Usage: parse <corpus>
+
+#define PARSE_ITERATIONS 200
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <corpus>\n", argv[0]);
+    return 1;
+  }
+
+  replay_corpus_t *corpus = replay_loadCorpus(argv[1]);
+  if (corpus == 0)
+    return 1;
+
+  size_t lines = corpus->count * PARSE_ITERATIONS;
+  size_t lowPriority = 0;
+  uint64_t start = replay_now();
+  for (size_t iteration = 0; iteration < PARSE_ITERATIONS; iteration++) {
+    for (size_t i = 0; i < corpus->count; i++) {
+      irc_classification_t classification;
+      irc_classify(corpus->lines[i], &classification);
+      lowPriority += classification.priority == IRC_PRIORITY_LOW;
+    }
+  }
+  uint64_t classifyElapsed = replay_now() - start;
+
+  // Parsing modifies the line, so every iteration parses a fresh copy like the one read from the connection
+  char line[IRC_MESSAGE_MAX_SIZE];
+  size_t parsed = 0;
+  start = replay_now();
+  for (size_t iteration = 0; iteration < PARSE_ITERATIONS; iteration++) {
+    for (size_t i = 0; i < corpus->count; i++) {
+      size_t length = corpus->lengths[i] < IRC_MESSAGE_MAX_SIZE ? corpus->lengths[i] : IRC_MESSAGE_MAX_SIZE - 1;
+      memcpy(line, corpus->lines[i], length);
+      line[length] = 0;
+      irc_message_t message;
+      parsed += irc_parse(line, &message);
+    }
+  }
+  uint64_t parseElapsed = replay_now() - start;
+
+  printf("parse: %zu lines (%zu PRIVMSGs, %zu parsed). irc_classify %.2fM lines/s, irc_parse %.2fM lines/s (%.0f ns/line)\n", corpus->count, lowPriority / PARSE_ITERATIONS, parsed / PARSE_ITERATIONS, lines * 1000.0 / classifyElapsed, lines * 1000.0 / parseElapsed, (double)parseElapsed / lines);
+
+  replay_freeCorpus(corpus);
+  return 0;
+}
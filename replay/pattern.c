@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "irc/irc.h"
+#include "logging/logging.h"
+#include "pattern/pattern.h"
+#include "resources/resources.h"
+#include "unicode/unicode.h"
+
+#include "replay.h"
+
+// Compare matching the words of the corpus' messages against the watchlists using the compiled automaton with
+// the linear scan over every entry it replaced, then measure how both scale with the number of entries
+// Usage: pattern <corpus>
+
+#define PATTERN_ITERATIONS 20
+#define PATTERN_SYNTHETIC_LOOKUPS 200000
+#define PATTERN_SYNTHETIC_MAX_LINEAR 100000
+#define PATTERN_SYNTHETIC_MAX_ENTRIES 1000000
+
+// The linear scan previously used by resources_countWord, returning a bit mask of the matching sources
+static uint32_t pattern_matchLinear(const char *word) {
+  for (size_t i = 0; RESOURCES_IGNORES[i] != 0; i++) {
+    if (strcmp(word, RESOURCES_IGNORES[i]) == 0)
+      return RESOURCES_IGNORED;
+  }
+
+  uint32_t matched = 0;
+  char **sources[RESOURCES_DATA_SOURCES] = {RESOURCES_USA_GENERAL_EN_US, RESOURCES_USA_NSA_EN_US};
+  for (size_t source = 0; source < RESOURCES_DATA_SOURCES; source++) {
+    for (size_t i = 0; sources[source][i] != 0; i++) {
+      if (strcmp(word, sources[source][i]) == 0) {
+        matched |= 1u << source;
+        break;
+      }
+    }
+  }
+
+  return matched;
+}
+
+// The normalized words of the corpus' PRIVMSGs, as split by the bot
+static size_t pattern_loadWords(replay_corpus_t *corpus, char ***words) {
+  size_t capacity = 1024;
+  size_t count = 0;
+  *words = malloc(sizeof(char *) * capacity);
+  for (size_t i = 0; i < corpus->count; i++) {
+    char line[IRC_MESSAGE_MAX_SIZE];
+    size_t length = corpus->lengths[i] < IRC_MESSAGE_MAX_SIZE ? corpus->lengths[i] : IRC_MESSAGE_MAX_SIZE - 1;
+    memcpy(line, corpus->lines[i], length);
+    line[length] = 0;
+    irc_message_t message;
+    if (!irc_parse(line, &message) || strcmp(message.type, "PRIVMSG") != 0 || message.message == 0 || !unicode_isValid(message.message, strlen(message.message)))
+      continue;
+
+    char folded[IRC_MESSAGE_MAX_SIZE];
+    length = unicode_fold(message.message, strlen(message.message), folded);
+    size_t start = 0;
+    for (size_t j = 0; j < length + 1; j++) {
+      if (j < length && folded[j] != ' ')
+        continue;
+      size_t offset = 0;
+      size_t wordLength = unicode_trim(folded + start, j - start, &offset);
+      if (wordLength > 0) {
+        if (count == capacity) {
+          capacity *= 2;
+          *words = realloc(*words, sizeof(char *) * capacity);
+        }
+        (*words)[count] = malloc(wordLength + 1);
+        memcpy((*words)[count], folded + start + offset, wordLength);
+        (*words)[count][wordLength] = 0;
+        count++;
+      }
+      start = j + 1;
+    }
+  }
+
+  return count;
+}
+
+// Measure lookups of random words, half of them entries, with a number of random entries
+static bool pattern_measureSynthetic(size_t entryCount) {
+  char (*entries)[16] = malloc(sizeof(char[16]) * entryCount);
+  pattern_t *pattern = pattern_create();
+  for (size_t i = 0; i < entryCount; i++) {
+    size_t length = 4 + rand() % 8;
+    for (size_t j = 0; j < length; j++)
+      entries[i][j] = 'a' + rand() % 26;
+    entries[i][length] = 0;
+    pattern_add(pattern, entries[i], length, 1);
+  }
+  pattern_compile(pattern);
+
+  char (*lookups)[16] = malloc(sizeof(char[16]) * PATTERN_SYNTHETIC_LOOKUPS);
+  for (size_t i = 0; i < PATTERN_SYNTHETIC_LOOKUPS; i++) {
+    if (i % 2 == 0) {
+      memcpy(lookups[i], entries[rand() % entryCount], 16);
+    } else {
+      size_t length = 4 + rand() % 8;
+      for (size_t j = 0; j < length; j++)
+        lookups[i][j] = 'a' + rand() % 26;
+      lookups[i][length] = 0;
+    }
+  }
+
+  size_t matched = 0;
+  size_t linearLookups = PATTERN_SYNTHETIC_LOOKUPS / 100;
+  size_t matchedByLinearLookups = 0;
+  uint64_t start = replay_now();
+  for (size_t i = 0; i < PATTERN_SYNTHETIC_LOOKUPS; i++) {
+    matched += pattern_match(pattern, lookups[i], strlen(lookups[i])) != 0;
+    if (i + 1 == linearLookups)
+      matchedByLinearLookups = matched;
+  }
+  double automaton = (double)(replay_now() - start) / PATTERN_SYNTHETIC_LOOKUPS;
+
+  printf("pattern: %7zu entries (%zu states). Automaton %.0f ns/lookup", entryCount, pattern->stateCount, automaton);
+  bool agreed = true;
+  if (entryCount <= PATTERN_SYNTHETIC_MAX_LINEAR) {
+    // The linear scan is slow enough to only need a fraction of the lookups
+    size_t linearMatched = 0;
+    start = replay_now();
+    for (size_t i = 0; i < linearLookups; i++) {
+      for (size_t j = 0; j < entryCount; j++) {
+        if (strcmp(lookups[i], entries[j]) == 0) {
+          linearMatched++;
+          break;
+        }
+      }
+    }
+    double linear = (double)(replay_now() - start) / linearLookups;
+    printf(", linear scan %.0f ns/lookup (%.0fx)", linear, linear / automaton);
+    agreed = linearMatched == matchedByLinearLookups;
+  }
+  printf(". %zu matched%s\n", matched, agreed ? "" : ", disagreeing with the linear scan");
+
+  pattern_free(pattern);
+  free(entries);
+  free(lookups);
+  return agreed;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <corpus>\n", argv[0]);
+    return 1;
+  }
+
+  replay_corpus_t *corpus = replay_loadCorpus(argv[1]);
+  if (corpus == 0)
+    return 1;
+
+  LOGGING_LEVEL = LOG_ERROR;
+  resources_initialize(false);
+
+  char **words = 0;
+  size_t wordCount = pattern_loadWords(corpus, &words);
+
+  // Both must agree on every word of the corpus
+  size_t disagreements = 0;
+  size_t matches = 0;
+  for (size_t i = 0; i < wordCount; i++) {
+    size_t occurances[RESOURCES_DATA_SOURCES] = {0};
+    bool counted = resources_countWord(words[i], occurances);
+    uint32_t linear = pattern_matchLinear(words[i]);
+    bool linearCounted = (linear & RESOURCES_IGNORED) == 0 && (linear & RESOURCES_ALL_SOURCES) != 0;
+    disagreements += counted != linearCounted;
+    matches += counted;
+  }
+
+  size_t sink = 0;
+  uint64_t start = replay_now();
+  for (size_t iteration = 0; iteration < PATTERN_ITERATIONS; iteration++) {
+    for (size_t i = 0; i < wordCount; i++)
+      sink += pattern_matchLinear(words[i]);
+  }
+  double linear = (double)(replay_now() - start) / (wordCount * PATTERN_ITERATIONS);
+
+  start = replay_now();
+  for (size_t iteration = 0; iteration < PATTERN_ITERATIONS; iteration++) {
+    for (size_t i = 0; i < wordCount; i++) {
+      size_t occurances[RESOURCES_DATA_SOURCES] = {0};
+      sink += resources_countWord(words[i], occurances);
+    }
+  }
+  double automaton = (double)(replay_now() - start) / (wordCount * PATTERN_ITERATIONS);
+
+  printf("pattern: corpus %zu words, %zu matches, %zu disagreements. Linear scan %.0f ns/word, automaton %.0f ns/word (%.0fx)\n", wordCount, matches, disagreements, linear, automaton, linear / automaton);
+
+  srand(1);
+  for (size_t entryCount = 1000; entryCount <= PATTERN_SYNTHETIC_MAX_ENTRIES; entryCount *= 10) {
+    if (!pattern_measureSynthetic(entryCount))
+      disagreements++;
+  }
+
+  for (size_t i = 0; i < wordCount; i++)
+    free(words[i]);
+  free(words);
+  resources_free();
+  replay_freeCorpus(corpus);
+  return sink == 0 || disagreements != 0;
+}
@@ -0,0 +1,83 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Helpers shared by the module benchmarks in replay/. Each benchmark is built by "make benchmark" and is given
+// the path to a corpus of recorded IRC traffic
+
+// A corpus loaded into memory, split into NUL-terminated lines without line endings
+typedef struct {
+  char *data;
+  char **lines;
+  size_t *lengths;
+  size_t count;
+  size_t size;
+} replay_corpus_t;
+
+static inline replay_corpus_t *replay_loadCorpus(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (file == 0) {
+    fprintf(stderr, "Unable to open corpus '%s'\n", path);
+    return 0;
+  }
+
+  replay_corpus_t *corpus = malloc(sizeof(replay_corpus_t));
+  memset(corpus, 0, sizeof(replay_corpus_t));
+  fseek(file, 0, SEEK_END);
+  corpus->size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  corpus->data = malloc(corpus->size + 1);
+  if (fread(corpus->data, 1, corpus->size, file) != corpus->size) {
+    fprintf(stderr, "Unable to read corpus '%s'\n", path);
+    fclose(file);
+    return 0;
+  }
+  corpus->data[corpus->size] = 0;
+  fclose(file);
+
+  size_t capacity = 1;
+  for (size_t i = 0; i < corpus->size; i++)
+    capacity += corpus->data[i] == '\n';
+  corpus->lines = malloc(sizeof(char *) * capacity);
+  corpus->lengths = malloc(sizeof(size_t) * capacity);
+
+  char *line = corpus->data;
+  while (line < corpus->data + corpus->size) {
+    char *end = strchr(line, '\n');
+    if (end == 0)
+      end = corpus->data + corpus->size;
+    char *next = end < corpus->data + corpus->size ? end + 1 : end;
+    if (end > line && end[-1] == '\r')
+      end--;
+    *end = 0;
+    if (end > line) {
+      corpus->lines[corpus->count] = line;
+      corpus->lengths[corpus->count] = end - line;
+      corpus->count++;
+    }
+    line = next;
+  }
+
+  return corpus;
+}
+
+static inline void replay_freeCorpus(replay_corpus_t *corpus) {
+  free(corpus->data);
+  free(corpus->lines);
+  free(corpus->lengths);
+  free(corpus);
+}
+
+// Monotonic time in nanoseconds
+static inline uint64_t replay_now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+#endif
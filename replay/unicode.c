@@ -0,0 +1,194 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "unicode/unicode.h"
+
+#include "replay.h"
+
+// Compare the throughput of the vectorized UTF-8 validator with a validator checking one sequence at a time, and
+// that of normalizing (folding and splitting into trimmed words) text in different scripts with that of ASCII
+// Usage: unicode <corpus>
+
+#define UNICODE_ITERATIONS 200
+#define UNICODE_RANDOM_CASES 1000000
+#define UNICODE_NORMALIZE_ITERATIONS 50000
+#define UNICODE_NORMALIZE_ROUNDS 5
+// Normalizing multibyte text must be at most this many times slower than ASCII, per byte
+#define UNICODE_MAX_NORMALIZE_SLOWDOWN 2.0
+
+// Text in a few scripts, mixing two, three and four byte sequences with ASCII
+static const char *unicode_sampleNames[] = {"ASCII", "German", "Russian", "Japanese", "French"};
+static const char *unicode_samples[] = {
+    "The surveillance of telecommunications was expanded, the newspaper reports.",
+    "Die Überwachung des Fernmeldeverkehrs wurde ausgeweitet, berichtet die Zeitung.",
+    "Совет безопасности обсудил ситуацию на границе и меры по её урегулированию.",
+    "東京の会議では、通信の監視について長い議論が行われました。",
+    "La réunion a été reportée à cause de la grève générale 🚧 selon les syndicats.",
+};
+
+// Reference validator, decoding one byte at a time
+static bool unicode_isValidScalar(const char *string, size_t length) {
+  const unsigned char *bytes = (const unsigned char *)string;
+  size_t i = 0;
+  while (i < length) {
+    unsigned char lead = bytes[i];
+    size_t sequenceLength = 0;
+    uint32_t codePoint = 0;
+    if (lead < 0x80) {
+      i++;
+      continue;
+    } else if ((lead & 0xE0) == 0xC0) {
+      sequenceLength = 2;
+      codePoint = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+      sequenceLength = 3;
+      codePoint = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+      sequenceLength = 4;
+      codePoint = lead & 0x07;
+    } else {
+      return false;
+    }
+
+    if (i + sequenceLength > length)
+      return false;
+    for (size_t j = 1; j < sequenceLength; j++) {
+      if ((bytes[i + j] & 0xC0) != 0x80)
+        return false;
+      codePoint = (codePoint << 6) | (bytes[i + j] & 0x3F);
+    }
+
+    static const uint32_t minimum[] = {0, 0, 0x80, 0x800, 0x10000};
+    if (codePoint < minimum[sequenceLength] || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+      return false;
+    i += sequenceLength;
+  }
+
+  return true;
+}
+
+static double unicode_measure(bool (*validate)(const char *, size_t), char **lines, size_t *lengths, size_t count, size_t bytes) {
+  size_t valid = 0;
+  uint64_t start = replay_now();
+  for (size_t iteration = 0; iteration < UNICODE_ITERATIONS; iteration++) {
+    for (size_t i = 0; i < count; i++)
+      valid += validate(lines[i], lengths[i]);
+  }
+  uint64_t elapsed = replay_now() - start;
+  if (valid != count * UNICODE_ITERATIONS)
+    fprintf(stderr, "Unexpected invalid lines\n");
+  return (double)bytes * UNICODE_ITERATIONS * 1000.0 / (elapsed > 0 ? elapsed : 1);
+}
+
+// Fold a line and split it into trimmed words the way the bot does, returns the number of words
+static size_t unicode_normalize(const char *line, size_t length, char *buffer) {
+  length = unicode_fold(line, length, buffer);
+  size_t words = 0;
+  size_t start = 0;
+  for (size_t i = 0; i < length + 1; i++) {
+    if (i == length || buffer[i] == ' ') {
+      size_t offset = 0;
+      words += unicode_trim(buffer + start, i - start, &offset) > 0;
+      start = i + 1;
+    }
+  }
+
+  return words;
+}
+
+// Best throughput of normalizing a line repeatedly over a few rounds, in MB/s
+static double unicode_measureNormalize(const char *line, size_t length) {
+  char buffer[512];
+  double best = 0;
+  for (size_t round = 0; round < UNICODE_NORMALIZE_ROUNDS; round++) {
+    size_t words = 0;
+    uint64_t start = replay_now();
+    for (size_t iteration = 0; iteration < UNICODE_NORMALIZE_ITERATIONS; iteration++)
+      words += unicode_normalize(line, length, buffer);
+    uint64_t elapsed = replay_now() - start;
+    if (words == 0)
+      fprintf(stderr, "Unexpected empty line\n");
+    double throughput = (double)length * UNICODE_NORMALIZE_ITERATIONS * 1000.0 / (elapsed > 0 ? elapsed : 1);
+    best = throughput > best ? throughput : best;
+  }
+  return best;
+}
+
+static void unicode_compare(const char *name, char **lines, size_t *lengths, size_t count) {
+  size_t bytes = 0;
+  for (size_t i = 0; i < count; i++)
+    bytes += lengths[i];
+
+  double scalar = unicode_measure(unicode_isValidScalar, lines, lengths, count, bytes);
+  double vectorized = unicode_measure(unicode_isValid, lines, lengths, count, bytes);
+  printf("unicode: %-9s %zu lines, %zu bytes. Scalar %.0f MB/s, unicode_isValid %.0f MB/s (%.1fx)\n", name, count, bytes, scalar, vectorized, vectorized / scalar);
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <corpus>\n", argv[0]);
+    return 1;
+  }
+
+  replay_corpus_t *corpus = replay_loadCorpus(argv[1]);
+  if (corpus == 0)
+    return 1;
+
+  // Random short sequences, biased towards the bytes that matter, must be judged the same by both validators
+  srand(1);
+  static const unsigned char interesting[] = {0x00, 0x41, 0x7F, 0x80, 0x8F, 0x90, 0x9F, 0xA0, 0xBF, 0xC0, 0xC1, 0xC2, 0xDF, 0xE0, 0xE1, 0xEC, 0xED, 0xEE, 0xEF, 0xF0, 0xF1, 0xF3, 0xF4, 0xF5, 0xFF};
+  char random[40];
+  for (size_t i = 0; i < UNICODE_RANDOM_CASES; i++) {
+    size_t length = rand() % sizeof(random);
+    for (size_t j = 0; j < length; j++)
+      random[j] = rand() % 4 == 0 ? 'a' : (char)interesting[rand() % sizeof(interesting)];
+    if (unicode_isValid(random, length) != unicode_isValidScalar(random, length)) {
+      fprintf(stderr, "unicode: validators disagree on case %zu\n", i);
+      return 1;
+    }
+  }
+
+  unicode_compare("corpus", corpus->lines, corpus->lengths, corpus->count);
+
+  // Lines as long as the longest IRC message, so that every block contains multibyte sequences
+  size_t sampleCount = sizeof(unicode_samples) / sizeof(unicode_samples[0]);
+  char *samples[sizeof(unicode_samples) / sizeof(unicode_samples[0])];
+  size_t sampleLengths[sizeof(unicode_samples) / sizeof(unicode_samples[0])];
+  for (size_t i = 0; i < sampleCount; i++) {
+    size_t length = strlen(unicode_samples[i]);
+    samples[i] = malloc(512);
+    sampleLengths[i] = 0;
+    while (sampleLengths[i] + length + 1 <= 512) {
+      memcpy(samples[i] + sampleLengths[i], unicode_samples[i], length);
+      sampleLengths[i] += length;
+      samples[i][sampleLengths[i]++] = ' ';
+    }
+  }
+  // As many lines as the corpus, to measure the same amount of work
+  char **lines = malloc(sizeof(char *) * corpus->count);
+  size_t *lengths = malloc(sizeof(size_t) * corpus->count);
+  for (size_t i = 0; i < corpus->count; i++) {
+    lines[i] = samples[1 + i % (sampleCount - 1)];
+    lengths[i] = sampleLengths[1 + i % (sampleCount - 1)];
+  }
+  unicode_compare("non-ASCII", lines, lengths, corpus->count);
+
+  // The first sample is ASCII, which every other script is compared with
+  bool withinBound = true;
+  double ascii = unicode_measureNormalize(samples[0], sampleLengths[0]);
+  printf("unicode: normalize %-8s %.0f MB/s\n", unicode_sampleNames[0], ascii);
+  for (size_t i = 1; i < sampleCount; i++) {
+    double throughput = unicode_measureNormalize(samples[i], sampleLengths[i]);
+    printf("unicode: normalize %-8s %.0f MB/s (%.2fx the time of ASCII)\n", unicode_sampleNames[i], throughput, ascii / throughput);
+    withinBound = withinBound && ascii / throughput <= UNICODE_MAX_NORMALIZE_SLOWDOWN;
+  }
+
+  free(lines);
+  free(lengths);
+  for (size_t i = 0; i < sampleCount; i++)
+    free(samples[i]);
+  replay_freeCorpus(corpus);
+  return withinBound ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../logging/logging.h"
+
+#include "arena.h"
+
+arena_t *arena_create(size_t size) {
+  arena_t *arena = malloc(sizeof(arena_t));
+  if (arena == 0) {
+    log(LOG_ERROR, "Unable to allocate arena");
+    return 0;
+  }
+  memset(arena, 0, sizeof(arena_t));
+
+  arena->buffer = malloc(size);
+  if (arena->buffer == 0) {
+    log(LOG_ERROR, "Unable to allocate arena buffer");
+    free(arena);
+    return 0;
+  }
+  arena->size = size;
+
+  return arena;
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+  arena->allocations++;
+
+  // Round up to keep every allocation aligned
+  size_t alignedSize = (size + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1);
+  if (alignedSize <= arena->size - arena->offset) {
+    void *pointer = arena->buffer + arena->offset;
+    arena->offset += alignedSize;
+    if (arena->offset > arena->highWaterMark)
+      arena->highWaterMark = arena->offset;
+    return pointer;
+  }
+
+  // The arena is exhausted, fall back to the heap. The header is padded to keep the alignment
+  arena->overflowAllocations++;
+  log(LOG_DEBUG, "Arena exhausted, allocating %zu bytes on the heap", size);
+  arena_overflow_t *overflow = malloc(ARENA_ALIGNMENT + size);
+  if (overflow == 0) {
+    log(LOG_ERROR, "Unable to allocate arena overflow");
+    return 0;
+  }
+  overflow->next = arena->overflow;
+  arena->overflow = overflow;
+
+  return (char *)overflow + ARENA_ALIGNMENT;
+}
+
+char *arena_copyString(arena_t *arena, const char *string, size_t length) {
+  char *copy = arena_alloc(arena, sizeof(char) * (length + 1));
+  if (copy == 0)
+    return 0;
+
+  memcpy(copy, string, length);
+  copy[length] = 0;
+  return copy;
+}
+
+void arena_reset(arena_t *arena) {
+  while (arena->overflow != 0) {
+    arena_overflow_t *next = arena->overflow->next;
+    free(arena->overflow);
+    arena->overflow = next;
+  }
+
+  arena->offset = 0;
+  arena->resets++;
+}
+
+void arena_free(arena_t *arena) {
+  arena_reset(arena);
+  free(arena->buffer);
+  free(arena);
+}
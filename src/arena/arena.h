@@ -0,0 +1,42 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Large enough for a maximum sized IRC message, its parsed fields, normalized copy and reply
+#define ARENA_DEFAULT_SIZE 8192
+#define ARENA_ALIGNMENT 16
+
+// A heap allocation made when the arena's block is exhausted
+typedef struct arena_overflow_t {
+  struct arena_overflow_t *next;
+} arena_overflow_t;
+
+// Bump-pointer allocator. Allocations are released all at once using arena_reset
+typedef struct {
+  char *buffer;
+  size_t size;
+  size_t offset;
+  arena_overflow_t *overflow;
+
+  // Statistics since creation
+  size_t allocations;
+  size_t overflowAllocations;
+  size_t resets;
+  size_t highWaterMark;
+} arena_t;
+
+arena_t *arena_create(size_t size);
+
+// Allocate memory from the arena, falling back to the heap if the arena is exhausted
+void *arena_alloc(arena_t *arena, size_t size);
+// Copy length bytes of a string to the arena and null-terminate it
+char *arena_copyString(arena_t *arena, const char *string, size_t length);
+
+// Release all allocations. O(1) unless heap fallbacks were needed
+void arena_reset(arena_t *arena);
+
+void arena_free(arena_t *arena);
+
+#endif
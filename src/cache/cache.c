@@ -0,0 +1,83 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../hash/hash.h"
+#include "../logging/logging.h"
+
+#include "cache.h"
+
+cache_t *cache_create() {
+  cache_t *cache = malloc(sizeof(cache_t));
+  if (cache == 0) {
+    log(LOG_ERROR, "Unable to allocate cache");
+    return 0;
+  }
+  memset(cache, 0, sizeof(cache_t));
+
+  return cache;
+}
+
+uint64_t cache_key(const char *message, size_t length) {
+  return hash_bytes(message, length, HASH_SEED);
+}
+
+bool cache_get(cache_t *cache, uint64_t key, const char *message, size_t length, size_t *occurances, char *terms) {
+  cache_entry_t *set = cache->entries[key % CACHE_SETS];
+  for (size_t i = 0; i < CACHE_WAYS; i++) {
+    // The hash rejects most entries, the message itself rules out collisions
+    if (set[i].used && set[i].key == key && set[i].length == length && memcmp(set[i].message, message, length) == 0) {
+      set[i].referenced = true;
+      memcpy(occurances, set[i].occurances, sizeof(size_t) * RESOURCES_DATA_SOURCES);
+      memcpy(terms, set[i].terms, CACHE_TERMS_SIZE);
+      cache->hits++;
+      return true;
+    }
+  }
+
+  cache->misses++;
+  return false;
+}
+
+void cache_put(cache_t *cache, uint64_t key, const char *message, size_t length, const size_t *occurances, const char *terms) {
+  if (length > CACHE_MESSAGE_SIZE)
+    return;
+
+  size_t setIndex = key % CACHE_SETS;
+  cache_entry_t *set = cache->entries[setIndex];
+
+  // Advance the clock hand until an unreferenced (or unused) entry is found,
+  // giving referenced entries a second chance
+  cache_entry_t *entry = 0;
+  while (entry == 0) {
+    cache_entry_t *candidate = &set[cache->hands[setIndex]];
+    cache->hands[setIndex] = (cache->hands[setIndex] + 1) % CACHE_WAYS;
+    if (!candidate->used || !candidate->referenced)
+      entry = candidate;
+    else
+      candidate->referenced = false;
+  }
+
+  if (entry->used)
+    cache->evictions++;
+
+  entry->key = key;
+  entry->length = length;
+  memcpy(entry->message, message, length);
+  entry->used = true;
+  entry->referenced = false;
+  memcpy(entry->occurances, occurances, sizeof(size_t) * RESOURCES_DATA_SOURCES);
+  strncpy(entry->terms, terms, CACHE_TERMS_SIZE - 1);
+  entry->terms[CACHE_TERMS_SIZE - 1] = 0;
+}
+
+double cache_hitRate(cache_t *cache) {
+  size_t lookups = cache->hits + cache->misses;
+  if (lookups == 0)
+    return 0;
+
+  return 100.0 * cache->hits / lookups;
+}
+
+void cache_free(cache_t *cache) {
+  free(cache);
+}
@@ -0,0 +1,55 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../resources/resources.h"
+
+// The cache is set-associative: a key maps to one set and is only probed against that set's ways.
+// Eviction within a set uses the CLOCK algorithm. Memory is fixed at CACHE_SETS * CACHE_WAYS entries
+#define CACHE_SETS 128
+#define CACHE_WAYS 4
+// Size of the space-separated list of matched terms kept per entry (including null-termination)
+#define CACHE_TERMS_SIZE 128
+// Longest normalized message that is cached. Entries keep the full message so that hash collisions are never hits
+#define CACHE_MESSAGE_SIZE 512
+
+typedef struct {
+  uint64_t key;
+  size_t length;
+  char message[CACHE_MESSAGE_SIZE];
+  bool used;
+  bool referenced;
+  size_t occurances[RESOURCES_DATA_SOURCES];
+  char terms[CACHE_TERMS_SIZE];
+} cache_entry_t;
+
+typedef struct {
+  cache_entry_t entries[CACHE_SETS][CACHE_WAYS];
+  uint8_t hands[CACHE_SETS];
+
+  size_t hits;
+  size_t misses;
+  size_t evictions;
+} cache_t;
+
+cache_t *cache_create();
+
+// Hash a normalized message into a cache key
+uint64_t cache_key(const char *message, size_t length);
+
+// Copy the cached occurances and matched terms (CACHE_TERMS_SIZE bytes) for a message with the given key,
+// returns false if the message is not cached
+bool cache_get(cache_t *cache, uint64_t key, const char *message, size_t length, size_t *occurances, char *terms);
+// Cache the occurances and matched terms (truncated to CACHE_TERMS_SIZE bytes) for a message with the given key.
+// Messages longer than CACHE_MESSAGE_SIZE are not cached
+void cache_put(cache_t *cache, uint64_t key, const char *message, size_t length, const size_t *occurances, const char *terms);
+
+// Hit rate in percent since creation
+double cache_hitRate(cache_t *cache);
+
+void cache_free(cache_t *cache);
+
+#endif
@@ -0,0 +1,46 @@
+#include <string.h>
+#include <strings.h>
+
+#include "dispatch.h"
+
+uint64_t dispatch_getKey(const char *name, size_t length, bool caseSensitive) {
+  if (length == 0 || length > DISPATCH_MAX_NAME_SIZE)
+    return 0;
+
+  uint64_t key = 0;
+  for (size_t i = 0; i < length; i++) {
+    unsigned char current = name[i];
+    if (!caseSensitive && current >= 'A' && current <= 'Z')
+      current += 'a' - 'A';
+    key |= (uint64_t)current << (8 * i);
+  }
+
+  return key;
+}
+
+uint64_t dispatch_getBotCommandKey(const char *nick, const char *message, const char **arguments) {
+  // The message must start with the nick followed by ':' or ','
+  size_t nickLength = strlen(nick);
+  if (strncasecmp(message, nick, nickLength) != 0)
+    return 0;
+  const char *cursor = message + nickLength;
+  if (*cursor != ':' && *cursor != ',')
+    return 0;
+  cursor++;
+
+  while (*cursor == ' ')
+    cursor++;
+
+  const char *command = cursor;
+  while (*cursor != ' ' && *cursor != 0)
+    cursor++;
+  size_t commandLength = cursor - command;
+
+  while (*cursor == ' ')
+    cursor++;
+
+  if (arguments != 0)
+    *arguments = cursor;
+
+  return dispatch_getKey(command, commandLength, false);
+}
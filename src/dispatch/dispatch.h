@@ -0,0 +1,29 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../irc/irc.h"
+
+// Names (IRC commands, numerics or bot commands) are packed into a key, one byte per character
+#define DISPATCH_MAX_NAME_SIZE 8
+
+// Key of a name given as characters, such as DISPATCH_KEY('P', 'I', 'N', 'G'). A constant usable as a case label
+#define DISPATCH_KEY(...) DISPATCH_PACK(__VA_ARGS__, 0, 0, 0, 0, 0, 0, 0, 0)
+#define DISPATCH_PACK(a, b, c, d, e, f, g, h, ...) \
+  ((uint64_t)(a) | (uint64_t)(b) << 8 | (uint64_t)(c) << 16 | (uint64_t)(d) << 24 | (uint64_t)(e) << 32 | (uint64_t)(f) << 40 | (uint64_t)(g) << 48 | (uint64_t)(h) << 56)
+
+// Handlers get the message and, for bot commands, the arguments following the command (otherwise 0)
+typedef void (*dispatch_handler_t)(irc_message_t *message, const char *arguments);
+
+// Pack a name into its key, folding ASCII to lowercase if the name is case insensitive.
+// Returns 0, which matches no key, if the name is empty or longer than DISPATCH_MAX_NAME_SIZE
+uint64_t dispatch_getKey(const char *name, size_t length, bool caseSensitive);
+
+// Get the key of the command of a message addressed to the bot, such as "<nick>: <command> <arguments>".
+// Commands are case insensitive. Returns 0 if the message is not addressed to the nick
+uint64_t dispatch_getBotCommandKey(const char *nick, const char *message, const char **arguments);
+
+#endif
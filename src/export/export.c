@@ -0,0 +1,253 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../logging/logging.h"
+
+#include "export.h"
+
+static void export_open(export_t *export) {
+  export->lastOpenAttempt = export_now();
+
+  if (!export->isSocket) {
+    export->descriptor = open(export->path, O_WRONLY | O_CREAT | O_APPEND | O_NONBLOCK, 0644);
+    if (export->descriptor == -1)
+      log(LOG_WARNING, "Unable to open export file '%s': %s", export->path, strerror(errno));
+    return;
+  }
+
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(struct sockaddr_un));
+  address.sun_family = AF_UNIX;
+  if (strlen(export->path) >= sizeof(address.sun_path)) {
+    log(LOG_ERROR, "Export socket path '%s' is too long", export->path);
+    return;
+  }
+  strcpy(address.sun_path, export->path);
+
+  export->descriptor = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (export->descriptor == -1) {
+    log(LOG_WARNING, "Unable to create export socket: %s", strerror(errno));
+    return;
+  }
+
+  if (connect(export->descriptor, (struct sockaddr *)&address, sizeof(struct sockaddr_un)) == -1 && errno != EINPROGRESS) {
+    log(LOG_WARNING, "Unable to connect to export socket '%s': %s", export->path, strerror(errno));
+    close(export->descriptor);
+    export->descriptor = -1;
+  }
+}
+
+export_t *export_create(const char *target) {
+  export_t *export = malloc(sizeof(export_t));
+  if (export == 0) {
+    log(LOG_ERROR, "Unable to allocate export");
+    return 0;
+  }
+  memset(export, 0, sizeof(export_t));
+
+  export->isSocket = strncmp(target, EXPORT_SOCKET_PREFIX, strlen(EXPORT_SOCKET_PREFIX)) == 0;
+  if (export->isSocket)
+    target += strlen(EXPORT_SOCKET_PREFIX);
+
+  export->path = strdup(target);
+  if (export->path == 0) {
+    log(LOG_ERROR, "Unable to allocate export path");
+    free(export);
+    return 0;
+  }
+
+  export->descriptor = -1;
+  export_open(export);
+
+  return export;
+}
+
+// Append a JSON string (including quotes) to a record. Returns false if it does not fit
+static bool export_appendString(char *record, size_t *offset, const char *string) {
+  size_t current = *offset;
+  if (current + 1 >= EXPORT_RECORD_SIZE)
+    return false;
+  record[current++] = '"';
+
+  for (const unsigned char *character = (const unsigned char *)string; *character != 0; character++) {
+    // Make room for the longest escape sequence, the closing quote and null-termination
+    if (current + 8 >= EXPORT_RECORD_SIZE)
+      return false;
+
+    if (*character == '"' || *character == '\\') {
+      record[current++] = '\\';
+      record[current++] = *character;
+    } else if (*character < 0x20) {
+      current += snprintf(record + current, EXPORT_RECORD_SIZE - current, "\\u%04x", *character);
+    } else {
+      record[current++] = *character;
+    }
+  }
+
+  record[current++] = '"';
+  *offset = current;
+  return true;
+}
+
+// Append formatted text to a record. Returns false if it does not fit
+static bool export_appendRaw(char *record, size_t *offset, const char *text) {
+  size_t length = strlen(text);
+  if (*offset + length >= EXPORT_RECORD_SIZE)
+    return false;
+
+  memcpy(record + *offset, text, length);
+  *offset += length;
+  return true;
+}
+
+static bool export_formatEvent(char *record, size_t *length, const export_event_t *event) {
+  size_t offset = 0;
+  char timestamp[32];
+  snprintf(timestamp, sizeof(timestamp), "%llu", (unsigned long long)event->timestamp);
+
+  bool fits = export_appendRaw(record, &offset, "{\"timestamp\":") && export_appendRaw(record, &offset, timestamp);
+  fits = fits && export_appendRaw(record, &offset, ",\"server\":") && export_appendString(record, &offset, event->server);
+  fits = fits && export_appendRaw(record, &offset, ",\"channel\":") && export_appendString(record, &offset, event->channel);
+  fits = fits && export_appendRaw(record, &offset, ",\"sender\":") && export_appendString(record, &offset, event->sender);
+
+  fits = fits && export_appendRaw(record, &offset, ",\"sources\":{");
+  for (size_t i = 0; fits && i < RESOURCES_DATA_SOURCES; i++) {
+    char count[32];
+    snprintf(count, sizeof(count), ":%zu", event->occurances[i]);
+    fits = (i == 0 || export_appendRaw(record, &offset, ",")) && export_appendString(record, &offset, resources_getSourceName(i)) && export_appendRaw(record, &offset, count);
+  }
+
+  fits = fits && export_appendRaw(record, &offset, "},\"terms\":[");
+  const char *term = event->terms;
+  bool first = true;
+  while (fits && *term != 0) {
+    const char *end = strchr(term, ' ');
+    size_t termLength = end == 0 ? strlen(term) : (size_t)(end - term);
+    if (termLength > 0) {
+      char copy[EXPORT_RECORD_SIZE];
+      memcpy(copy, term, termLength);
+      copy[termLength] = 0;
+      fits = (first || export_appendRaw(record, &offset, ",")) && export_appendString(record, &offset, copy);
+      first = false;
+    }
+    term += termLength + (end == 0 ? 0 : 1);
+  }
+
+  fits = fits && export_appendRaw(record, &offset, "]}\n");
+  *length = offset;
+  return fits;
+}
+
+void export_add(export_t *export, const export_event_t *event) {
+  if (export->count == EXPORT_MAX_RECORDS)
+    export_flush(export);
+
+  if (export->count == EXPORT_MAX_RECORDS) {
+    export->dropped++;
+    log(LOG_DEBUG, "Export buffer is full, dropped %zu events in total", export->dropped);
+    return;
+  }
+
+  size_t slot = export->head;
+  if (!export_formatEvent(export->records[slot], &export->lengths[slot], event)) {
+    export->dropped++;
+    log(LOG_DEBUG, "Event too large to export, dropped %zu events in total", export->dropped);
+    return;
+  }
+
+  export->head = (export->head + 1) % EXPORT_MAX_RECORDS;
+  export->count++;
+  if (export->count == 1)
+    export->oldestAdded = export_now();
+
+  if (export->count >= EXPORT_BATCH_SIZE)
+    export_flush(export);
+}
+
+void export_flush(export_t *export) {
+  if (export->count == 0)
+    return;
+
+  if (export->descriptor == -1) {
+    if (export_now() - export->lastOpenAttempt < EXPORT_REOPEN_INTERVAL)
+      return;
+    export_open(export);
+    if (export->descriptor == -1)
+      return;
+  }
+
+  struct iovec vectors[EXPORT_MAX_RECORDS];
+  size_t tail = (export->head + EXPORT_MAX_RECORDS - export->count) % EXPORT_MAX_RECORDS;
+  for (size_t i = 0; i < export->count; i++) {
+    size_t slot = (tail + i) % EXPORT_MAX_RECORDS;
+    size_t skip = i == 0 ? export->written : 0;
+    vectors[i].iov_base = export->records[slot] + skip;
+    vectors[i].iov_len = export->lengths[slot] - skip;
+  }
+
+  ssize_t bytesWritten = writev(export->descriptor, vectors, export->count);
+  if (bytesWritten == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOTCONN)
+      return;
+
+    log(LOG_WARNING, "Unable to write export events: %s", strerror(errno));
+    close(export->descriptor);
+    export->descriptor = -1;
+    // A partially written record can't be completed on a new connection
+    if (export->written > 0) {
+      export->count--;
+      export->written = 0;
+      export->dropped++;
+    }
+    return;
+  }
+
+  export->flushes++;
+
+  // Release the records which were completely written
+  size_t remaining = bytesWritten;
+  while (export->count > 0) {
+    size_t slot = (export->head + EXPORT_MAX_RECORDS - export->count) % EXPORT_MAX_RECORDS;
+    size_t left = export->lengths[slot] - export->written;
+    if (remaining < left) {
+      export->written += remaining;
+      break;
+    }
+
+    remaining -= left;
+    export->written = 0;
+    export->count--;
+    export->exported++;
+  }
+
+  if (export->count > 0)
+    export->oldestAdded = export_now();
+}
+
+void export_poll(export_t *export) {
+  if (export->count > 0 && export_now() - export->oldestAdded >= EXPORT_FLUSH_INTERVAL)
+    export_flush(export);
+}
+
+uint64_t export_now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+void export_free(export_t *export) {
+  // Make a last, non-blocking, attempt to deliver pending events
+  export_flush(export);
+  if (export->descriptor != -1)
+    close(export->descriptor);
+  free(export->path);
+  free(export);
+}
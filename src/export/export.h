@@ -0,0 +1,69 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../resources/resources.h"
+
+// Prefix of an export target which is a UNIX domain socket rather than a file
+#define EXPORT_SOCKET_PREFIX "unix:"
+
+// Number of records that can be pending at once. Records are dropped when all are in use
+#define EXPORT_MAX_RECORDS 64
+#define EXPORT_RECORD_SIZE 1024
+// Flush once this many records are pending...
+#define EXPORT_BATCH_SIZE 32
+// ...or once the oldest pending record is this old (milliseconds)
+#define EXPORT_FLUSH_INTERVAL 1000
+// Minimum time between attempts to reopen the target (milliseconds)
+#define EXPORT_REOPEN_INTERVAL 5000
+
+typedef struct {
+  // Milliseconds since the epoch
+  uint64_t timestamp;
+  const char *server;
+  const char *channel;
+  const char *sender;
+  const size_t *occurances;
+  // Space-separated list of matched terms
+  const char *terms;
+} export_event_t;
+
+// A sink writing one JSON object per line for each match. Writes never block;
+// records are buffered in a preallocated ring and flushed in batches using writev
+typedef struct {
+  char *path;
+  bool isSocket;
+  int descriptor;
+  uint64_t lastOpenAttempt;
+
+  char records[EXPORT_MAX_RECORDS][EXPORT_RECORD_SIZE];
+  size_t lengths[EXPORT_MAX_RECORDS];
+  size_t head;
+  size_t count;
+  // Bytes of the oldest pending record which have already been written
+  size_t written;
+  uint64_t oldestAdded;
+
+  size_t exported;
+  size_t dropped;
+  size_t flushes;
+} export_t;
+
+// Create a sink writing to a file or, if prefixed with "unix:", a UNIX domain socket
+export_t *export_create(const char *target);
+
+void export_add(export_t *export, const export_event_t *event);
+// Write as many pending records as possible without blocking
+void export_flush(export_t *export);
+// Flush if the oldest pending record has passed the deadline
+void export_poll(export_t *export);
+
+// Monotonic time in milliseconds
+uint64_t export_now();
+
+void export_free(export_t *export);
+
+#endif
@@ -0,0 +1,73 @@
+#include <string.h>
+#include <sys/random.h>
+
+#include "../logging/logging.h"
+
+#include "hash.h"
+
+#define HASH_SECRET_0 0xA0761D6478BD642FULL
+#define HASH_SECRET_1 0xE7037ED1A0B428DBULL
+#define HASH_SECRET_2 0x8EBC6AF09C88C6E3ULL
+
+uint64_t HASH_SEED = HASH_DEFAULT_SEED;
+
+// 128-bit integers are a GCC / Clang extension
+__extension__ typedef unsigned __int128 hash_uint128_t;
+
+// Multiply two 64-bit values into 128 bits and fold the halves together
+static uint64_t hash_mix(uint64_t a, uint64_t b) {
+  hash_uint128_t product = (hash_uint128_t)a * b;
+  return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+static uint64_t hash_read64(const uint8_t *data) {
+  uint64_t value;
+  memcpy(&value, data, sizeof(uint64_t));
+  return value;
+}
+
+static uint64_t hash_read32(const uint8_t *data) {
+  uint32_t value;
+  memcpy(&value, data, sizeof(uint32_t));
+  return value;
+}
+
+uint64_t hash_bytes(const void *data, size_t length, uint64_t seed) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  seed ^= HASH_SECRET_0;
+
+  uint64_t a = 0;
+  uint64_t b = 0;
+  if (length <= 16) {
+    if (length >= 4) {
+      // Read the first and last 4 (overlapping) bytes of each half
+      a = (hash_read32(bytes) << 32) | hash_read32(bytes + ((length >> 3) << 2));
+      b = (hash_read32(bytes + length - 4) << 32) | hash_read32(bytes + length - 4 - ((length >> 3) << 2));
+    } else if (length > 0) {
+      a = ((uint64_t)bytes[0] << 16) | ((uint64_t)bytes[length >> 1] << 8) | bytes[length - 1];
+    }
+  } else {
+    size_t remaining = length;
+    while (remaining > 16) {
+      seed = hash_mix(hash_read64(bytes) ^ HASH_SECRET_1, hash_read64(bytes + 8) ^ seed);
+      bytes += 16;
+      remaining -= 16;
+    }
+    // The last 16 bytes, possibly overlapping with already consumed ones
+    a = hash_read64(bytes + remaining - 16);
+    b = hash_read64(bytes + remaining - 8);
+  }
+
+  return hash_mix(HASH_SECRET_1 ^ length, hash_mix(a ^ HASH_SECRET_1, b ^ seed) ^ HASH_SECRET_2);
+}
+
+bool hash_randomizeSeed() {
+  uint64_t seed;
+  if (getentropy(&seed, sizeof(uint64_t)) == -1) {
+    log(LOG_WARNING, "Unable to get a random hash seed, using the default");
+    return false;
+  }
+
+  HASH_SEED = seed;
+  return true;
+}
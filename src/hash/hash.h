@@ -0,0 +1,20 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Must differ from the secrets mixed into the seed
+#define HASH_DEFAULT_SEED 0x9E3779B97F4A7C15ULL
+
+// Seed of tables keyed on untrusted text, HASH_DEFAULT_SEED until hash_randomizeSeed is called
+extern uint64_t HASH_SEED;
+
+// Choose a random HASH_SEED so that collisions can't be predicted. Call before creating any tables
+bool hash_randomizeSeed();
+
+// Fast non-cryptographic 64-bit hash (wyhash-style multiply-mix), not suitable for untrusted keys in security contexts
+uint64_t hash_bytes(const void *data, size_t length, uint64_t seed);
+
+#endif
@@ -1,6 +1,8 @@
+#include <stdio.h>
 #include <string.h>
 
 #include "../logging/logging.h"
+#include "../trace/trace.h"
 
 #include "irc.h"
 
@@ -18,9 +20,17 @@ irc_t *irc_connect(char *hostname, uint16_t port, char *user, char *nick, char *
   irc->nick = nick;
   irc->gecos = gecos;
 
+  // All memory used to handle a single message is allocated from the arena
+  irc->arena = arena_create(ARENA_DEFAULT_SIZE);
+  if (irc->arena == 0) {
+    free(irc);
+    return 0;
+  }
+
   irc->tls = tls_connect(hostname, port);
   if (irc->tls == 0) {
     log(LOG_ERROR, "Unable to connect to server '%s'", hostname);
+    arena_free(irc->arena);
     free(irc);
     return 0;
   }
@@ -36,6 +46,36 @@ irc_t *irc_connect(char *hostname, uint16_t port, char *user, char *nick, char *
   return irc;
 }
 
+irc_t *irc_replay(const char *path, char *nick) {
+  irc_t *irc = malloc(sizeof(irc_t));
+  if (irc == 0) {
+    log(LOG_ERROR, "Unable to allocate IRC structure");
+    return 0;
+  }
+  memset(irc, 0, sizeof(irc_t));
+
+  irc->hostname = "replay";
+  irc->nick = nick;
+
+  irc->arena = arena_create(ARENA_DEFAULT_SIZE);
+  if (irc->arena == 0) {
+    free(irc);
+    return 0;
+  }
+
+  irc->replay = fopen(path, "r");
+  if (irc->replay == 0) {
+    log(LOG_ERROR, "Unable to open replay '%s'", path);
+    arena_free(irc->arena);
+    free(irc);
+    return 0;
+  }
+
+  log(LOG_DEBUG, "Replaying messages from '%s'", path);
+
+  return irc;
+}
+
 void irc_write(irc_t *irc, const char *format, ...) {
   va_list arguments;
 
@@ -48,7 +88,7 @@ void irc_write(irc_t *irc, const char *format, ...) {
     return;
   }
 
-  char *message = malloc(messageLength + 1);
+  char *message = arena_alloc(irc->arena, messageLength + 1);
   if (message == 0) {
     log(LOG_ERROR, "Unable to allocate message");
     return;
@@ -58,109 +98,348 @@ void irc_write(irc_t *irc, const char *format, ...) {
   vsnprintf(message, messageLength + 1, format, arguments);
   va_end(arguments);
 
-  tls_write(irc->tls, message, messageLength);
-  free(message);
+  // Messages are formatted but not sent when replaying
+  if (irc->tls != 0)
+    tls_write(irc->tls, message, messageLength);
+  irc->writtenAt = trace_now();
 }
 
 void irc_pong(irc_t *irc, const char *server, const char *server2) {
   irc_write(irc, "PONG %s %s", server, server2);
 }
 
-irc_message_t *irc_read(irc_t *irc) {
-  irc_message_t *message = malloc(sizeof(irc_message_t));
-  if (message == 0) {
-    log(LOG_ERROR, "Unable to allocate message");
-    return 0;
+// Character classes used by the parser
+#define IRC_CLASS_OTHER 0
+#define IRC_CLASS_END 1
+#define IRC_CLASS_SPACE 2
+#define IRC_CLASS_LETTER 3
+#define IRC_CLASS_DIGIT 4
+
+#define O IRC_CLASS_OTHER
+#define E IRC_CLASS_END
+#define S IRC_CLASS_SPACE
+#define L IRC_CLASS_LETTER
+#define D IRC_CLASS_DIGIT
+static const uint8_t irc_characterClasses[256] = {
+    E, O, O, O, O, O, O, O, O, O, E, O, O, E, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    S, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    D, D, D, D, D, D, D, D, D, D, O, O, O, O, O, O,
+    O, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+    L, L, L, L, L, L, L, L, L, L, L, O, O, O, O, O,
+    O, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L,
+    L, L, L, L, L, L, L, L, L, L, L, O, O, O, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+    O, O, O, O, O, O, O, O, O, O, O, O, O, O, O, O,
+};
+#undef O
+#undef E
+#undef S
+#undef L
+#undef D
+
+#define irc_class(character) irc_characterClasses[(uint8_t)(character)]
+#define irc_isEnd(character) (irc_class(character) == IRC_CLASS_END)
+#define irc_isSpace(character) (irc_class(character) == IRC_CLASS_SPACE)
+#define irc_isDelimiter(character) (irc_class(character) <= IRC_CLASS_SPACE && irc_class(character) != IRC_CLASS_OTHER)
+
+// Unescape an IRCv3 tag value in place
+static void irc_unescapeTagValue(char *value) {
+  char *read = value;
+  char *write = value;
+  while (*read != 0) {
+    if (*read != '\\') {
+      *write++ = *read++;
+      continue;
+    }
+
+    read++;
+    if (*read == 0)
+      break;
+    else if (*read == ':')
+      *write++ = ';';
+    else if (*read == 's')
+      *write++ = ' ';
+    else if (*read == 'r')
+      *write++ = '\r';
+    else if (*read == 'n')
+      *write++ = '\n';
+    else
+      *write++ = *read;
+    read++;
   }
+  *write = 0;
+}
+
+bool irc_parse(char *line, irc_message_t *message) {
   memset(message, 0, sizeof(irc_message_t));
+  char *cursor = line;
 
-  char *buffer = tls_readLine(irc->tls, IRC_MESSAGE_TIMEOUT, IRC_MESSAGE_MAX_SIZE);
-  if (buffer == 0) {
-    log(LOG_ERROR, "Unable to read buffer");
-    free(message);
-    return 0;
+  // IRCv3 tags: @key=value;key2;key3=value3
+  if (*cursor == '@') {
+    cursor++;
+    while (!irc_isDelimiter(*cursor)) {
+      char *key = cursor;
+      char *value = 0;
+      while (!irc_isDelimiter(*cursor) && *cursor != ';') {
+        if (*cursor == '=' && value == 0) {
+          *cursor = 0;
+          value = cursor + 1;
+        }
+        cursor++;
+      }
+
+      bool last = *cursor != ';';
+      if (!last)
+        *cursor++ = 0;
+
+      if (*key != 0 && message->tagCount < IRC_MAX_TAGS) {
+        if (last) {
+          // Terminate the last tag without losing track of the delimiter
+          char delimiter = *cursor;
+          *cursor = 0;
+          if (value != 0)
+            irc_unescapeTagValue(value);
+          *cursor = delimiter;
+        } else if (value != 0) {
+          irc_unescapeTagValue(value);
+        }
+        message->tags[message->tagCount].key = key;
+        message->tags[message->tagCount].value = value == 0 ? "" : value;
+        message->tagCount++;
+      }
+    }
+
+    if (!irc_isSpace(*cursor))
+      return false;
+    *cursor++ = 0;
   }
 
-  size_t messageLength = strlen(buffer);
-  size_t start = 0;
-  for (size_t i = 0; i < messageLength + 1; i++) {
-    if (buffer[i] == ' ' || buffer[i] == 0) {
-      size_t valueLength = i - start;
-      if (message->sender == 0) {
-        if (strncmp(buffer, "PING", 4) == 0) {
-          message->type = malloc(sizeof(char) * 5);
-          memcpy(message->type, "PING", 4);
-          message->type[4] = 0;
+  while (irc_isSpace(*cursor))
+    cursor++;
 
-          message->message = malloc(sizeof(char) * (messageLength - 5 + 1));
-          memcpy(message->message, buffer + 5, messageLength - 5);
-          message->message[messageLength - 5] = 0;
+  // Prefix: :servername or :nick[!user][@host]
+  if (*cursor == ':') {
+    cursor++;
+    message->sender = cursor;
+    char *bang = 0;
+    char *at = 0;
+    while (!irc_isDelimiter(*cursor)) {
+      if (*cursor == '!' && bang == 0 && at == 0)
+        bang = cursor;
+      else if (*cursor == '@' && at == 0)
+        at = cursor;
+      cursor++;
+    }
 
-          break;
-        }
+    if (!irc_isSpace(*cursor))
+      return false;
+    *cursor++ = 0;
 
-        // The start of the username is always ':'
-        start++;
-        if (valueLength > 1)
-          valueLength--;
-
-        // The username ends with '!'
-        for (size_t j = 0; j < valueLength; j++) {
-          if (buffer[start + j] == '!') {
-            valueLength = j;
-            break;
-          }
-        }
+    if (bang != 0) {
+      *bang = 0;
+      message->user = bang + 1;
+    }
+    if (at != 0) {
+      *at = 0;
+      message->host = at + 1;
+    }
 
-        message->sender = malloc(sizeof(char) * (valueLength + 1));
-        memcpy(message->sender, buffer + start, (valueLength));
-        message->sender[valueLength] = 0;
-      } else if (message->type == 0) {
-        message->type = malloc(sizeof(char) * (valueLength + 1));
-        memcpy(message->type, buffer + start, (valueLength));
-        message->type[valueLength] = 0;
-      } else if (message->target == 0) {
-        message->target = malloc(sizeof(char) * (valueLength + 1));
-        memcpy(message->target, buffer + start, (valueLength));
-        message->target[valueLength] = 0;
-      } else if (message->message == 0) {
-        // The start of the message is always ':'
-        start++;
-        // The message occupies the rest of the string
-        valueLength = messageLength - start;
-
-        message->message = malloc(sizeof(char) * (valueLength + 1));
-        memcpy(message->message, buffer + start, (valueLength));
-        message->message[valueLength] = 0;
-        break;
-      }
+    while (irc_isSpace(*cursor))
+      cursor++;
+  }
+
+  // Command: letters or a three digit numeric
+  message->type = cursor;
+  bool numeric = true;
+  while (irc_class(*cursor) == IRC_CLASS_LETTER || irc_class(*cursor) == IRC_CLASS_DIGIT) {
+    numeric = numeric && irc_class(*cursor) == IRC_CLASS_DIGIT;
+    cursor++;
+  }
+  size_t typeLength = cursor - message->type;
+  if (typeLength == 0 || !irc_isDelimiter(*cursor))
+    return false;
+  if (numeric && typeLength == 3)
+    message->numeric = (message->type[0] - '0') * 100 + (message->type[1] - '0') * 10 + (message->type[2] - '0');
+
+  // Parameters: up to 14 middle parameters followed by an optional trailing one
+  while (true) {
+    bool end = irc_isEnd(*cursor);
+    *cursor = 0;
+    if (end)
+      break;
+    cursor++;
+
+    while (irc_isSpace(*cursor))
+      cursor++;
+    if (irc_isEnd(*cursor)) {
+      *cursor = 0;
+      break;
+    }
+
+    if (*cursor == ':' || message->parameterCount == IRC_MAX_PARAMETERS - 1) {
+      if (*cursor == ':')
+        cursor++;
+      message->parameters[message->parameterCount++] = cursor;
+      while (!irc_isEnd(*cursor))
+        cursor++;
+      *cursor = 0;
+      break;
+    }
+
+    message->parameters[message->parameterCount++] = cursor;
+    while (!irc_isDelimiter(*cursor))
+      cursor++;
+  }
+
+  if (message->parameterCount > 0) {
+    message->target = message->parameters[0];
+    message->message = message->parameters[message->parameterCount - 1];
+  }
+
+  return true;
+}
+
+const char *irc_getTag(irc_message_t *message, const char *key) {
+  for (size_t i = 0; i < message->tagCount; i++) {
+    if (strcmp(message->tags[i].key, key) == 0)
+      return message->tags[i].value;
+  }
+
+  return 0;
+}
+
+// Read the next line from a replay into the reused replay buffer, stripping the trailing CRLF
+static char *irc_readReplayLine(irc_t *irc, size_t *length) {
+  ssize_t lineLength = getline(&irc->replayBuffer, &irc->replayBufferSize, irc->replay);
+  // Skip lines which could not have been read from a connection
+  while (lineLength > IRC_MESSAGE_MAX_SIZE) {
+    log(LOG_WARNING, "Dropping a line of %zd bytes, longer than %d bytes", lineLength, IRC_MESSAGE_MAX_SIZE);
+    lineLength = getline(&irc->replayBuffer, &irc->replayBufferSize, irc->replay);
+  }
+  if (lineLength == -1)
+    return 0;
+
+  while (lineLength > 0 && (irc->replayBuffer[lineLength - 1] == '\n' || irc->replayBuffer[lineLength - 1] == '\r'))
+    irc->replayBuffer[--lineLength] = 0;
+
+  *length = lineLength;
+  return irc->replayBuffer;
+}
+
+void irc_classify(const char *line, irc_classification_t *classification) {
+  memset(classification, 0, sizeof(irc_classification_t));
+  classification->priority = IRC_PRIORITY_HIGH;
+  const char *cursor = line;
+
+  // Skip tags
+  if (*cursor == '@') {
+    while (!irc_isDelimiter(*cursor))
+      cursor++;
+  }
+  while (irc_isSpace(*cursor))
+    cursor++;
+
+  // The sender's nick is the prefix up to the user or host
+  const char *sender = 0;
+  size_t senderLength = 0;
+  if (*cursor == ':') {
+    sender = ++cursor;
+    while (!irc_isDelimiter(*cursor) && *cursor != '!' && *cursor != '@')
+      cursor++;
+    senderLength = cursor - sender;
+    while (!irc_isDelimiter(*cursor))
+      cursor++;
+    while (irc_isSpace(*cursor))
+      cursor++;
+  }
 
-      start = i + 1;
+  if (strncmp(cursor, "PRIVMSG", 7) != 0 || !irc_isSpace(cursor[7]))
+    return;
+
+  cursor += 7;
+  while (irc_isSpace(*cursor))
+    cursor++;
+  classification->priority = IRC_PRIORITY_LOW;
+  classification->sender = sender;
+  classification->senderLength = senderLength;
+  classification->target = cursor;
+  while (!irc_isDelimiter(*cursor))
+    cursor++;
+  classification->targetLength = cursor - classification->target;
+}
+
+bool irc_readLine(irc_t *irc, int timeout, irc_line_t *line) {
+  irc->timedOut = false;
+  line->line = irc->replay != 0 ? irc_readReplayLine(irc, &line->length) : tls_readLine(irc->tls, timeout, IRC_MESSAGE_MAX_SIZE, &line->length);
+  if (line->line == 0) {
+    if (irc->replay != 0) {
+      log(LOG_DEBUG, "Reached the end of the replay");
+    } else if (irc->tls->timedOut) {
+      irc->timedOut = true;
+    } else {
+      log(LOG_ERROR, "Unable to read buffer");
     }
+    return false;
+  }
+
+  line->readAt = trace_now();
+  // Replayed lines have no time of arrival
+  line->receivedAt = irc->replay != 0 ? line->readAt : irc->tls->lineTimestamp;
+  return true;
+}
+
+irc_message_t *irc_parseLine(irc_t *irc, irc_line_t *line) {
+  irc_message_t *message = arena_alloc(irc->arena, sizeof(irc_message_t));
+  if (message == 0) {
+    log(LOG_ERROR, "Unable to allocate message");
+    return 0;
+  }
+
+  // The message's fields point into the line, which stays put until the next line is read
+  if (!irc_parse(line->line, message)) {
+    log(LOG_WARNING, "Ignoring malformed message of %zu bytes", line->length);
+    return 0;
   }
 
-  free(buffer);
+  message->receivedAt = line->receivedAt;
+  message->readAt = line->readAt;
+  message->parsedAt = trace_now();
   return message;
 }
 
+irc_message_t *irc_read(irc_t *irc, int timeout) {
+  irc_line_t line;
+  while (irc_readLine(irc, timeout, &line)) {
+    irc_message_t *message = irc_parseLine(irc, &line);
+    if (message != 0)
+      return message;
+  }
+
+  return 0;
+}
+
 void irc_join(irc_t *irc, const char *channel) {
   irc_write(irc, "JOIN %s\r\n", channel);
 }
 
 void irc_free(irc_t *irc) {
-  tls_free(irc->tls);
+  if (irc->tls != 0)
+    tls_free(irc->tls);
+  if (irc->replay != 0)
+    fclose(irc->replay);
+  free(irc->replayBuffer);
+  arena_free(irc->arena);
   free(irc);
 }
 
-void irc_freeMessage(irc_message_t *message) {
-  if (message->sender != 0)
-    free(message->sender);
-  if (message->type != 0)
-    free(message->type);
-  if (message->target != 0)
-    free(message->target);
-  if (message->message != 0)
-    free(message->message);
-
-  free(message);
+void irc_freeMessage(irc_t *irc, irc_message_t *message) {
+  // The message and everything allocated while handling it lives in the arena
+  arena_reset(irc->arena);
 }
@@ -3,12 +3,18 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
+#include "../arena/arena.h"
 #include "../tls/tls.h"
 
-#define IRC_MESSAGE_MAX_SIZE 1024
+// IRCv3 allows up to 8191 bytes of message tags, including the leading '@' and the trailing space, in front of the
+// 512 bytes (including CRLF) of an RFC 1459 message. Longer lines are discarded
+#define IRC_MAX_TAGS_SIZE 8191
+#define IRC_MESSAGE_MAX_SIZE (IRC_MAX_TAGS_SIZE + 512)
+// Wait for messages without a timeout
 #define IRC_MESSAGE_TIMEOUT -1
 
 typedef struct {
@@ -19,16 +25,82 @@ typedef struct {
   char *gecos;
 
   tls_t *tls;
+  arena_t *arena;
+  // Recorded messages read instead of the connection when running offline, 0 otherwise
+  FILE *replay;
+  // Buffer reused for every replayed line
+  char *replayBuffer;
+  size_t replayBufferSize;
+  // Whether or not the last read timed out
+  bool timedOut;
+  // When a message was last written, in nanoseconds since the epoch
+  uint64_t writtenAt;
 } irc_t;
 
+#define IRC_MAX_PARAMETERS 15
+#define IRC_MAX_TAGS 32
+
+typedef struct {
+  char *key;
+  char *value;
+} irc_tag_t;
+
+// A parsed message. All fields point into the (modified) line the message was parsed from
 typedef struct {
+  irc_tag_t tags[IRC_MAX_TAGS];
+  uint8_t tagCount;
+
+  // The nick or server name of the prefix, 0 if there is no prefix
   char *sender;
+  char *user;
+  char *host;
+
+  // The command, such as PRIVMSG or 001
   char *type;
+  // The numeric reply code, 0 if the command is not numeric
+  uint16_t numeric;
+
+  char *parameters[IRC_MAX_PARAMETERS];
+  uint8_t parameterCount;
+
+  // Aliases for the first and last parameter, 0 if there are no parameters
   char *target;
   char *message;
+
+  // When the message passed through each stage, in nanoseconds since the epoch. See trace_record_t
+  uint64_t receivedAt;
+  uint64_t readAt;
+  uint64_t parsedAt;
+  uint64_t matchedAt;
 } irc_message_t;
 
+// Lines other than PRIVMSGs (PING, ERROR, numerics etc.) which are handled as soon as they are read
+#define IRC_PRIORITY_HIGH 0
+// PRIVMSGs, which may be queued and shed under load
+#define IRC_PRIORITY_LOW 1
+
+// A raw line as read from the server, before it is parsed. The line points into the connection's buffer
+typedef struct {
+  char *line;
+  size_t length;
+  // See irc_message_t
+  uint64_t receivedAt;
+  uint64_t readAt;
+} irc_line_t;
+
+// The result of classifying a raw line without parsing it
+typedef struct {
+  uint8_t priority;
+  // The sender's nick and the target of low priority lines, pointing into the line (not terminated)
+  const char *sender;
+  size_t senderLength;
+  const char *target;
+  size_t targetLength;
+} irc_classification_t;
+
 irc_t *irc_connect(char *hostname, uint16_t port, char *user, char *nick, char *gecos);
+// Run offline, reading raw IRC lines from a file. Written messages are discarded
+irc_t *irc_replay(const char *path, char *nick);
 
 void irc_disconnect(irc_t *irc);
 
@@ -40,9 +112,26 @@ void irc_send(irc_t *irc, const char *channel, const char *message);
 
 void irc_pong(irc_t *irc, const char *server, const char *server2);
 
-irc_message_t *irc_read(irc_t *irc);
+// Parse a RFC 1459 / IRCv3 line in place without allocating. Returns false if the line is malformed
+bool irc_parse(char *line, irc_message_t *message);
+// Get the unescaped value of a tag, 0 if the tag is not set
+const char *irc_getTag(irc_message_t *message, const char *key);
+
+// Cheaply classify a raw line by its command, without modifying or fully parsing it
+void irc_classify(const char *line, irc_classification_t *classification);
+
+// Read the next raw line, waiting at most timeout milliseconds (or IRC_MESSAGE_TIMEOUT to wait indefinitely).
+// The line is valid until the next read. Returns false on failure or timeout, in which case timedOut is set
+bool irc_readLine(irc_t *irc, int timeout, irc_line_t *line);
+// Parse a raw line in place into a message allocated from the arena. Returns 0 if the line is malformed
+irc_message_t *irc_parseLine(irc_t *irc, irc_line_t *line);
+
+// Read the next message, waiting at most timeout milliseconds (or IRC_MESSAGE_TIMEOUT to wait indefinitely).
+// Returns 0 on failure or timeout, in which case timedOut is set
+irc_message_t *irc_read(irc_t *irc, int timeout);
 
 void irc_free(irc_t *irc);
-void irc_freeMessage(irc_message_t *message);
+// Release the message and all other memory allocated from the arena since the last message
+void irc_freeMessage(irc_t *irc, irc_message_t *message);
 
 #endif
@@ -0,0 +1,114 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../logging/logging.h"
+
+#include "lag.h"
+
+lag_t *lag_create(uint64_t interval, uint8_t maxMissed) {
+  lag_t *lag = malloc(sizeof(lag_t));
+  if (lag == 0) {
+    log(LOG_ERROR, "Unable to allocate lag meter");
+    return 0;
+  }
+  memset(lag, 0, sizeof(lag_t));
+
+  lag->interval = interval;
+  lag->maxMissed = maxMissed;
+
+  return lag;
+}
+
+bool lag_poll(lag_t *lag, uint64_t now, char *token) {
+  if (lag->pending) {
+    if (now - lag->sentAt < lag->interval)
+      return false;
+
+    lag->pending = false;
+    lag->missed++;
+    lag->totalMissed++;
+    log(LOG_WARNING, "No PONG received for '%s' (%u missed in a row)", lag->token, lag->missed);
+  } else if (now - lag->sentAt < lag->interval) {
+    return false;
+  }
+
+  // The token carries the time it was sent
+  snprintf(lag->token, LAG_MAX_TOKEN_SIZE, LAG_TOKEN_PREFIX "%" PRIu64, now);
+  memcpy(token, lag->token, LAG_MAX_TOKEN_SIZE);
+  lag->sentAt = now;
+  lag->pending = true;
+
+  return true;
+}
+
+bool lag_handlePong(lag_t *lag, const char *token, uint64_t now) {
+  if (!lag->pending || strcmp(token, lag->token) != 0)
+    return false;
+
+  uint64_t roundTrip = now - lag->sentAt;
+  lag->pending = false;
+  lag->missed = 0;
+
+  lag->samples++;
+  lag->sum += roundTrip;
+  lag->last = roundTrip;
+  if (roundTrip > lag->max)
+    lag->max = roundTrip;
+
+  size_t bucket = 0;
+  while (bucket < LAG_BUCKETS - 1 && roundTrip >= ((uint64_t)2 << bucket))
+    bucket++;
+  lag->histogram[bucket]++;
+
+  log(LOG_DEBUG, "Server round trip took %" PRIu64 "ms", roundTrip);
+  return true;
+}
+
+bool lag_isDead(lag_t *lag) {
+  return lag->missed >= lag->maxMissed;
+}
+
+int lag_getTimeout(lag_t *lag, uint64_t now) {
+  uint64_t elapsed = now - lag->sentAt;
+  if (elapsed >= lag->interval)
+    return 0;
+
+  return (int)(lag->interval - elapsed);
+}
+
+uint64_t lag_getPercentile(lag_t *lag, uint8_t percentile) {
+  if (lag->samples == 0)
+    return 0;
+
+  uint64_t rank = (lag->samples * percentile + 99) / 100;
+  uint64_t seen = 0;
+  for (size_t bucket = 0; bucket < LAG_BUCKETS; bucket++) {
+    seen += lag->histogram[bucket];
+    // Report the upper bound of the bucket, but never more than the actual maximum
+    if (seen >= rank && rank > 0) {
+      uint64_t upper = ((uint64_t)2 << bucket) - 1;
+      return upper < lag->max ? upper : lag->max;
+    }
+  }
+
+  return lag->max;
+}
+
+void lag_reset(lag_t *lag, uint64_t now) {
+  lag->pending = false;
+  lag->missed = 0;
+  lag->sentAt = now;
+}
+
+uint64_t lag_now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+void lag_free(lag_t *lag) {
+  free(lag);
+}
@@ -0,0 +1,58 @@
+#ifndef LAG_H
+#define LAG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LAG_TOKEN_PREFIX "lag-"
+#define LAG_MAX_TOKEN_SIZE 32
+// Bucket i of the histogram counts round trips of [2^i, 2^(i+1)) milliseconds, the first bucket also counts 0 ms
+#define LAG_BUCKETS 20
+
+#define LAG_DEFAULT_INTERVAL 30
+#define LAG_DEFAULT_MAX_MISSED 3
+
+// Measures the round trip time to the server using client-initiated PINGs
+typedef struct {
+  // Milliseconds between PINGs, which is also how long to wait for a PONG
+  uint64_t interval;
+  // Number of consecutive missed PONGs after which the connection is considered dead
+  uint8_t maxMissed;
+
+  bool pending;
+  char token[LAG_MAX_TOKEN_SIZE];
+  uint64_t sentAt;
+  uint8_t missed;
+
+  uint64_t histogram[LAG_BUCKETS];
+  uint64_t samples;
+  uint64_t sum;
+  uint64_t last;
+  uint64_t max;
+  uint64_t totalMissed;
+} lag_t;
+
+lag_t *lag_create(uint64_t interval, uint8_t maxMissed);
+
+// Check for missed PONGs. If a PING is due, its token is written to token (LAG_MAX_TOKEN_SIZE bytes) and true is returned
+bool lag_poll(lag_t *lag, uint64_t now, char *token);
+// Handle a PONG, returns false if the token does not belong to the pending PING
+bool lag_handlePong(lag_t *lag, const char *token, uint64_t now);
+// Whether or not the connection should be considered dead
+bool lag_isDead(lag_t *lag);
+// Milliseconds until lag_poll needs to be called
+int lag_getTimeout(lag_t *lag, uint64_t now);
+
+// Estimate a percentile (0-100) of the round trip time in milliseconds from the histogram
+uint64_t lag_getPercentile(lag_t *lag, uint8_t percentile);
+
+// Start over, such as after reconnecting. Keeps the histogram
+void lag_reset(lag_t *lag, uint64_t now);
+
+// Monotonic time in milliseconds
+uint64_t lag_now();
+
+void lag_free(lag_t *lag);
+
+#endif
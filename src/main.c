@@ -1,31 +1,109 @@
+#include <inttypes.h>
 #include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
+#include "cache/cache.h"
+#include "dispatch/dispatch.h"
+#include "export/export.h"
+#include "hash/hash.h"
 #include "irc/irc.h"
+#include "lag/lag.h"
 #include "logging/logging.h"
 #include "resources/resources.h"
+#include "shed/shed.h"
+#include "stats/stats.h"
 #include "tls/tls.h"
+#include "trace/trace.h"
+#include "unicode/unicode.h"
+#include "window/window.h"
 
 #include "main.h"
 
 static irc_t *main_irc = 0;
 static irc_message_t *main_message = 0;
+static cache_t *main_cache = 0;
+// Per-channel sliding windows of watchlist hits
+static window_t *main_window = 0;
+// Heavy hitters among users, channels and terms
+static stats_t *main_stats = 0;
+// Sink for match events, 0 if exporting is disabled
+static export_t *main_export = 0;
+// Round trip time to the server, used to detect dead connections
+static lag_t *main_lag = 0;
+// Queue of PRIVMSGs waiting to be handled, shedding load under floods
+static shed_t *main_shed = 0;
+// Per-message latency trace, 0 if tracing is disabled
+static trace_t *main_trace = 0;
 
 int main(int argc, const char *argv[]) {
   // Setup signal handling for main process
   signal(SIGINT, main_handleSignalSIGINT);
   signal(SIGTERM, main_handleSignalSIGTERM);
+  // Writes to closed sockets (server or export consumer) are handled where they happen
+  signal(SIGPIPE, SIG_IGN);
 
   char *hostname = getenv("IRC_SERVER");
   char *portString = getenv("IRC_PORT");
-  uint16_t port = atoi(portString);
+  uint16_t port = portString == 0 ? MAIN_DEFAULT_PORT : atoi(portString);
   char *user = getenv("IRC_USER");
   char *nick = getenv("IRC_NICK");
+  if (nick == 0)
+    nick = MAIN_DEFAULT_NICK;
   char *gecos = getenv("IRC_GECOS");
   char *channel = getenv("IRC_CHANNEL");
 
+  // Run offline against recorded messages using --replay <path>
+  // Write a trace recorded using TRACE_PATH as Chrome trace event JSON using --dump-trace <path>
+  const char *replayPath = 0;
+  const char *dumpTracePath = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+      replayPath = argv[++i];
+    else if (strcmp(argv[i], "--dump-trace") == 0 && i + 1 < argc)
+      dumpTracePath = argv[++i];
+  }
+
+  char *windowMessagesString = getenv("WATCHLIST_WINDOW_MESSAGES");
+  size_t windowMessages = windowMessagesString == 0 ? WINDOW_DEFAULT_MESSAGES : (size_t)atoi(windowMessagesString);
+  char *windowDurationString = getenv("WATCHLIST_WINDOW_DURATION");
+  uint32_t windowDuration = windowDurationString == 0 ? WINDOW_DEFAULT_DURATION : (uint32_t)atoi(windowDurationString);
+  char *stemmingString = getenv("WATCHLIST_STEMMING");
+  bool stemming = stemmingString != 0 && strcmp(stemmingString, "1") == 0;
+  char *thresholdString = getenv("WATCHLIST_THRESHOLD");
+  uint32_t threshold = thresholdString == 0 ? WINDOW_DEFAULT_THRESHOLD : (uint32_t)atoi(thresholdString);
+
+  char *statsPath = getenv("STATS_PATH");
+  char *exportTarget = getenv("EXPORT_TARGET");
+  char *tracePath = getenv("TRACE_PATH");
+
+  // A zero interval would PING on every iteration and zero missed PONGs would reconnect forever
+  char *pingIntervalString = getenv("IRC_PING_INTERVAL");
+  int pingInterval = pingIntervalString == 0 ? LAG_DEFAULT_INTERVAL : atoi(pingIntervalString);
+  if (pingInterval <= 0) {
+    log(LOG_WARNING, "IRC_PING_INTERVAL must be at least 1 second, using %d", LAG_DEFAULT_INTERVAL);
+    pingInterval = LAG_DEFAULT_INTERVAL;
+  }
+  char *maxMissedPongsString = getenv("IRC_MAX_MISSED_PONGS");
+  int maxMissedPongs = maxMissedPongsString == 0 ? LAG_DEFAULT_MAX_MISSED : atoi(maxMissedPongsString);
+  if (maxMissedPongs < 1 || maxMissedPongs > UINT8_MAX) {
+    log(LOG_WARNING, "IRC_MAX_MISSED_PONGS must be between 1 and %d, using %d", UINT8_MAX, LAG_DEFAULT_MAX_MISSED);
+    maxMissedPongs = LAG_DEFAULT_MAX_MISSED;
+  }
+
+  char *sampleRateString = getenv("SHED_SAMPLE_RATE");
+  uint32_t sampleRate = sampleRateString == 0 ? SHED_DEFAULT_SAMPLE_RATE : (uint32_t)atoi(sampleRateString);
+  char *floodRateString = getenv("SHED_FLOOD_RATE");
+  uint32_t floodRate = floodRateString == 0 ? SHED_DEFAULT_FLOOD_RATE : (uint32_t)atoi(floodRateString);
+  char *maxLagString = getenv("SHED_MAX_LAG");
+  uint32_t maxLag = maxLagString == 0 ? SHED_DEFAULT_MAX_LAG : (uint32_t)atoi(maxLagString);
+
+  char *statsIntervalString = getenv("STATS_SNAPSHOT_INTERVAL");
+  uint32_t statsInterval = statsIntervalString == 0 ? STATS_DEFAULT_SNAPSHOT_INTERVAL : (uint32_t)atoi(statsIntervalString);
+
   char *logLevel = getenv("LOGGING_LEVEL");
   if (logLevel != 0) {
     if (strcasecmp(logLevel, "debug") == 0)
@@ -46,88 +124,437 @@ int main(int argc, const char *argv[]) {
       LOGGING_LEVEL = LOG_EMERGENCY;
   }
 
+  if (dumpTracePath != 0)
+    return trace_dump(dumpTracePath, stdout) ? 0 : 1;
+
+  // Untrusted users choose the channels and messages that are hashed
+  hash_randomizeSeed();
+
   tls_initialize();
 
-  main_irc = irc_connect(hostname, port, user, nick, gecos);
-  if (main_irc == 0) {
-    log(LOG_ERROR, "Unable to connect to the server");
+  if (!resources_initialize(stemming))
+    return 1;
+
+  main_cache = cache_create();
+  if (main_cache == 0)
+    return 1;
+
+  main_window = window_create(windowMessages, windowDuration, threshold);
+  if (main_window == 0)
     return 1;
+
+  main_stats = stats_create(statsPath, statsInterval);
+  if (main_stats == 0)
+    return 1;
+
+  if (exportTarget != 0) {
+    main_export = export_create(exportTarget);
+    if (main_export == 0)
+      return 1;
   }
 
-  irc_join(main_irc, channel);
+  main_lag = lag_create((uint64_t)pingInterval * 1000, (uint8_t)maxMissedPongs);
+  if (main_lag == 0)
+    return 1;
 
-  while (true) {
-    main_message = irc_read(main_irc);
-    if (main_message == 0) {
-      log(LOG_ERROR, "Unable to read message from server");
-      break;
+  main_shed = shed_create(sampleRate, floodRate, maxLag);
+  if (main_shed == 0)
+    return 1;
+
+  if (tracePath != 0) {
+    main_trace = trace_create(tracePath);
+    if (main_trace == 0)
+      return 1;
+  }
+
+  if (replayPath != 0) {
+    main_irc = irc_replay(replayPath, nick);
+    if (main_irc == 0)
+      return 1;
+  } else {
+    main_irc = irc_connect(hostname, port, user, nick, gecos);
+    if (main_irc == 0) {
+      log(LOG_ERROR, "Unable to connect to the server");
+      return 1;
     }
 
-    log(LOG_DEBUG, "Got message '%s' (type '%s') from '%s' in '%s'", main_message->message, main_message->type, main_message->sender, main_message->target);
+    irc_join(main_irc, channel);
+  }
 
-    if (strcmp(main_message->type, "PING") == 0) {
-      irc_write(main_irc, "PONG :%s\r\n", main_message->message);
+  lag_reset(main_lag, lag_now());
 
-      irc_freeMessage(main_message);
-      main_message = 0;
+  while (true) {
+    // When connected, wake up in time to send PINGs, detect missed PONGs and snapshot statistics even if the
+    // server is quiet. Queued PRIVMSGs are handled as soon as there is nothing to read
+    int timeout = main_irc->replay != 0 ? IRC_MESSAGE_TIMEOUT : lag_getTimeout(main_lag, lag_now());
+    int statsTimeout = stats_getTimeout(main_stats, window_now());
+    if (main_irc->replay == 0 && statsTimeout >= 0 && statsTimeout < timeout)
+      timeout = statsTimeout;
+    if (main_shed->count > 0)
+      timeout = 0;
+
+    irc_line_t line;
+    if (irc_readLine(main_irc, timeout, &line)) {
+      // PINGs, numerics and the like are handled right away. Replays are handled in order without shedding
+      irc_classification_t classification;
+      irc_classify(line.line, &classification);
+      if (classification.priority == IRC_PRIORITY_LOW && main_irc->replay == 0)
+        shed_push(main_shed, &line, &classification, trace_now());
+      else
+        main_handleLine(&line);
+    } else if (!main_irc->timedOut) {
+      if (main_irc->replay != 0)
+        break;
+
+      log(LOG_ERROR, "Unable to read message from server, reconnecting");
+      main_reconnect(hostname, port, user, nick, gecos, channel);
       continue;
     }
-    if (strcmp(main_message->type, "PRIVMSG") != 0) {
-      irc_freeMessage(main_message);
-      main_message = 0;
-      continue;
+
+    // Lines which are already available are read first, so that PINGs and the like never wait behind queued
+    // PRIVMSGs. Once there is nothing left to read or the queue is half full, handle queued PRIVMSGs for a while
+    if (main_irc->timedOut || main_shed->count >= SHED_HIGH_WATER) {
+      uint64_t deadline = trace_now() + MAIN_QUEUE_BUDGET;
+      irc_line_t queued;
+      while (shed_pop(main_shed, &queued)) {
+        main_handleLine(&queued);
+        if (trace_now() >= deadline)
+          break;
+      }
     }
 
-    if (strcasecmp(main_message->message, "watchlist-bot: help") == 0)
-      main_handleHelp();
-    else
-      main_handleWatchlist();
+    if (main_export != 0)
+      export_poll(main_export);
+
+    stats_snapshot(main_stats, window_now());
 
-    irc_freeMessage(main_message);
-    main_message = 0;
+    if (main_irc->replay == 0) {
+      char token[LAG_MAX_TOKEN_SIZE];
+      if (lag_poll(main_lag, lag_now(), token))
+        irc_write(main_irc, "PING :%s\r\n", token);
+
+      if (lag_isDead(main_lag)) {
+        log(LOG_ERROR, "Missed %u PONGs in a row, reconnecting", main_lag->missed);
+        main_reconnect(hostname, port, user, nick, gecos, channel);
+      }
+    }
   }
 
   irc_free(main_irc);
   main_irc = 0;
+  cache_free(main_cache);
+  main_cache = 0;
+  window_free(main_window);
+  main_window = 0;
+  lag_free(main_lag);
+  main_lag = 0;
+  stats_free(main_stats);
+  main_stats = 0;
+  if (main_export != 0)
+    export_free(main_export);
+  main_export = 0;
+  shed_free(main_shed);
+  main_shed = 0;
+  if (main_trace != 0)
+    trace_free(main_trace);
+  main_trace = 0;
+  resources_free();
   log(LOG_DEBUG, "Everything freed, closing");
 }
 
-void main_handleHelp() {
-  irc_write(main_irc, "PRIVMSG %s :%s\r\n", main_message->target, "I keep track of words used in nations' watchlists. I currently handle English words watched by NSA and USA in general.");
+void main_reconnect(char *hostname, uint16_t port, char *user, char *nick, char *gecos, char *channel) {
+  irc_free(main_irc);
+  main_irc = 0;
+
+  // Back off exponentially, up to a limit, until the server is reachable again
+  unsigned int delay = 1;
+  while (true) {
+    log(LOG_INFO, "Reconnecting to '%s:%d' in %u seconds", hostname, port, delay);
+    sleep(delay);
+
+    main_irc = irc_connect(hostname, port, user, nick, gecos);
+    if (main_irc != 0)
+      break;
+
+    delay *= 2;
+    if (delay > MAIN_MAX_RECONNECT_DELAY)
+      delay = MAIN_MAX_RECONNECT_DELAY;
+  }
+
+  irc_join(main_irc, channel);
+  lag_reset(main_lag, lag_now());
 }
 
-void main_handleWatchlist() {
-  size_t messageLength = strlen(main_message->message);
-  char *message = main_message->message;
-  size_t start = 0;
+void main_handleLine(irc_line_t *line) {
+  main_message = irc_parseLine(main_irc, line);
+  if (main_message == 0) {
+    irc_freeMessage(main_irc, 0);
+    return;
+  }
+
+  log(LOG_DEBUG, "Got message '%s' (type '%s') from '%s' in '%s'", main_message->message, main_message->type, main_message->sender, main_message->target);
+
+  dispatch_handler_t handler = main_findCommand(dispatch_getKey(main_message->type, strlen(main_message->type), true));
+  if (handler != 0)
+    handler(main_message, 0);
+
+  if (main_trace != 0)
+    main_traceMessage(main_message);
+
+  irc_freeMessage(main_irc, main_message);
+  main_message = 0;
+}
+
+dispatch_handler_t main_findCommand(uint64_t key) {
+  switch (key) {
+  case DISPATCH_KEY('P', 'I', 'N', 'G'):
+    return main_handlePing;
+  case DISPATCH_KEY('P', 'O', 'N', 'G'):
+    return main_handlePong;
+  case DISPATCH_KEY('P', 'R', 'I', 'V', 'M', 'S', 'G'):
+    return main_handlePrivateMessage;
+  default:
+    return 0;
+  }
+}
+
+dispatch_handler_t main_findBotCommand(uint64_t key) {
+  switch (key) {
+  case DISPATCH_KEY('h', 'e', 'l', 'p'):
+    return main_handleHelp;
+  case DISPATCH_KEY('s', 't', 'a', 't', 's'):
+    return main_handleStats;
+  case DISPATCH_KEY('l', 'a', 'g'):
+    return main_handleLag;
+  case DISPATCH_KEY('l', 'o', 'a', 'd'):
+    return main_handleLoad;
+  default:
+    return 0;
+  }
+}
+
+void main_handlePing(irc_message_t *message, const char *arguments) {
+  irc_write(main_irc, "PONG :%s\r\n", message->message == 0 ? "" : message->message);
+}
+
+void main_handlePong(irc_message_t *message, const char *arguments) {
+  if (message->message != 0)
+    lag_handlePong(main_lag, message->message, lag_now());
+}
+
+void main_handlePrivateMessage(irc_message_t *message, const char *arguments) {
+  if (message->parameterCount < 2)
+    return;
+
+  const char *commandArguments = 0;
+  dispatch_handler_t handler = main_findBotCommand(dispatch_getBotCommandKey(main_irc->nick, message->message, &commandArguments));
+  if (handler != 0)
+    handler(message, commandArguments);
+  else
+    main_handleWatchlist(message);
+}
+
+void main_handleHelp(irc_message_t *message, const char *arguments) {
+  irc_write(main_irc, "PRIVMSG %s :%s\r\n", message->target, "I keep track of words used in nations' watchlists. I currently handle English words watched by NSA and USA in general.");
+}
+
+void main_handleStats(irc_message_t *message, const char *arguments) {
+  // "stats <key>" estimates how often a single user, channel or term has triggered
+  if (arguments != 0 && arguments[0] != 0) {
+    uint32_t users = stats_estimate(main_stats, STATS_DIMENSION_USERS, arguments);
+    uint32_t channels = stats_estimate(main_stats, STATS_DIMENSION_CHANNELS, arguments);
+    uint32_t terms = stats_estimate(main_stats, STATS_DIMENSION_TERMS, arguments);
+    irc_write(main_irc, "PRIVMSG %s :'%s' triggered at most %u times as a user, %u times as a channel and %u times as a term\r\n", message->target, arguments, users, channels, terms);
+    return;
+  }
+
+  static const char *labels[STATS_DIMENSIONS] = {"users", "channels", "terms"};
+  char reply[IRC_MESSAGE_MAX_SIZE];
+  size_t offset = 0;
+  for (uint8_t dimension = 0; dimension < STATS_DIMENSIONS; dimension++) {
+    stats_item_t items[MAIN_STATS_TOP_SIZE];
+    size_t count = stats_getTop(main_stats, dimension, items, MAIN_STATS_TOP_SIZE);
+
+    offset += snprintf(reply + offset, sizeof(reply) - offset, "%sTop %s:", dimension == 0 ? "" : " | ", labels[dimension]);
+    if (count == 0)
+      offset += snprintf(reply + offset, sizeof(reply) - offset, " none");
+    for (size_t i = 0; i < count && offset < sizeof(reply); i++)
+      offset += snprintf(reply + offset, sizeof(reply) - offset, " %s (%u)", items[i].key, items[i].count);
+    if (offset >= sizeof(reply))
+      break;
+  }
+
+  if (offset < sizeof(reply))
+    offset += snprintf(reply + offset, sizeof(reply) - offset, " | Cache: %.1f%% hit rate (%zu hits, %zu misses, %zu evictions)", cache_hitRate(main_cache), main_cache->hits, main_cache->misses, main_cache->evictions);
+
+  if (offset < sizeof(reply)) {
+    if (main_lag->samples == 0)
+      offset += snprintf(reply + offset, sizeof(reply) - offset, " | Lag: not measured yet");
+    else
+      offset += snprintf(reply + offset, sizeof(reply) - offset, " | Lag: last %" PRIu64 "ms, average %" PRIu64 "ms, p99 <= %" PRIu64 "ms, %" PRIu64 " missed PONGs", main_lag->last, main_lag->sum / main_lag->samples, lag_getPercentile(main_lag, 99), main_lag->totalMissed);
+  }
+
+  // Events are dropped when the export buffer is full or the sink fails, which would otherwise go unnoticed
+  if (main_export != 0 && offset < sizeof(reply))
+    snprintf(reply + offset, sizeof(reply) - offset, " | Export: %zu exported, %zu pending, %zu dropped", main_export->exported, main_export->count, main_export->dropped);
+
+  irc_write(main_irc, "PRIVMSG %s :%s\r\n", message->target, reply);
+}
+
+void main_handleLag(irc_message_t *message, const char *arguments) {
+  if (main_lag->samples == 0) {
+    irc_write(main_irc, "PRIVMSG %s :%s\r\n", message->target, "No round trips to the server have been measured yet");
+    return;
+  }
+
+  irc_write(main_irc, "PRIVMSG %s :Server round trip: last %" PRIu64 "ms, average %" PRIu64 "ms, p50 <= %" PRIu64 "ms, p99 <= %" PRIu64 "ms, max %" PRIu64 "ms, %" PRIu64 " missed PONGs\r\n", message->target, main_lag->last, main_lag->sum / main_lag->samples, lag_getPercentile(main_lag, 50), lag_getPercentile(main_lag, 99), main_lag->max, main_lag->totalMissed);
+}
+
+void main_handleLoad(irc_message_t *message, const char *arguments) {
+  uint64_t lag = shed_getLag(main_shed, 0, trace_now()) / 1000000;
+  irc_write(main_irc, "PRIVMSG %s :%zu of %d messages queued (oldest %" PRIu64 "ms behind), %zu handled. Shed %zu old messages, %zu by sampling and %zu from flooding senders\r\n", message->target, main_shed->count, SHED_QUEUE_SIZE, lag, main_shed->handled, main_shed->droppedOldest, main_shed->sampledOut, main_shed->flooded);
+}
+
+void main_handleWatchlist(irc_message_t *message) {
+  const char *text = message->message;
+  size_t messageLength = strlen(text);
+  if (!unicode_isValid(text, messageLength)) {
+    // Scan what can be decoded rather than ignoring the whole message
+    log(LOG_DEBUG, "Replacing invalid UTF-8 in message from '%s'", message->sender);
+    char *replaced = arena_alloc(main_irc->arena, sizeof(char) * (messageLength * 3 + 1));
+    if (replaced == 0) {
+      log(LOG_ERROR, "Unable to allocate replaced message");
+      return;
+    }
+    messageLength = unicode_replaceInvalid(text, messageLength, replaced);
+    text = replaced;
+  }
+
+  // Normalize the message the same way the resources are normalized at build time
+  char *normalizedMessage = arena_alloc(main_irc->arena, sizeof(char) * (messageLength + 1));
+  if (normalizedMessage == 0) {
+    log(LOG_ERROR, "Unable to allocate normalized message");
+    return;
+  }
+  messageLength = unicode_fold(text, messageLength, normalizedMessage);
+  normalizedMessage[messageLength] = 0;
+
   size_t occurances[RESOURCES_DATA_SOURCES] = {0};
+  // Space-separated list of matched terms
+  char terms[CACHE_TERMS_SIZE] = {0};
+  size_t termsLength = 0;
+
+  // Repeated lines (spam, bot floods) are answered from the cache instead of being rescanned
+  uint64_t key = cache_key(normalizedMessage, messageLength);
+  if (cache_get(main_cache, key, normalizedMessage, messageLength, occurances, terms)) {
+    log(LOG_DEBUG, "Message found in cache (hit rate %.1f%%)", cache_hitRate(main_cache));
+    message->matchedAt = trace_now();
+    main_handleMatch(message, occurances, terms);
+    return;
+  }
+
+  // The words are split in place, so keep the message the result is cached for
+  char *cacheMessage = arena_alloc(main_irc->arena, sizeof(char) * (messageLength + 1));
+  if (cacheMessage == 0) {
+    log(LOG_ERROR, "Unable to allocate cached message");
+    return;
+  }
+  memcpy(cacheMessage, normalizedMessage, messageLength + 1);
+
+  // Split the message into words in place and count each of them
+  size_t start = 0;
   for (size_t i = 0; i < messageLength + 1; i++) {
-    if (message[i] == ' ' || message[i] == 0) {
-      size_t wordLength = i - start;
+    if (normalizedMessage[i] == ' ' || normalizedMessage[i] == 0) {
+      size_t offset = 0;
+      size_t wordLength = unicode_trim(normalizedMessage + start, i - start, &offset);
+      if (wordLength > 0) {
+        char *word = normalizedMessage + start + offset;
+        // The terminator replaces the separator or trimmed punctuation, which have already been passed
+        word[wordLength] = 0;
+        // Keep as many terms as fit
+        if (resources_countWord(word, occurances) && termsLength + wordLength + 1 < CACHE_TERMS_SIZE) {
+          if (termsLength > 0)
+            terms[termsLength++] = ' ';
+          memcpy(terms + termsLength, word, wordLength + 1);
+          termsLength += wordLength;
+        }
+      }
+      start = i + 1;
+    }
+  }
 
-      char *word = malloc(sizeof(char) * (wordLength + 1));
-      memcpy(word, message + start, (wordLength));
-      word[wordLength] = 0;
+  cache_put(main_cache, key, cacheMessage, messageLength, occurances, terms);
+  message->matchedAt = trace_now();
+  main_handleMatch(message, occurances, terms);
+}
 
-      resources_countWord(word, occurances);
+void main_handleMatch(irc_message_t *message, size_t *occurances, const char *terms) {
+  const char *target = message->target;
+  uint32_t now = window_now();
+
+  bool matched = false;
+  for (size_t i = 0; i < RESOURCES_DATA_SOURCES; i++)
+    matched = matched || occurances[i] > 0;
+  if (matched) {
+    stats_add(main_stats, STATS_DIMENSION_USERS, message->sender == 0 ? "" : message->sender);
+    stats_add(main_stats, STATS_DIMENSION_CHANNELS, target);
+    // Terms are counted from the list kept in the cache, so scanned and cached messages count the same
+    char term[CACHE_TERMS_SIZE];
+    for (const char *start = terms; *start != 0;) {
+      const char *end = strchr(start, ' ');
+      size_t termLength = end == 0 ? strlen(start) : (size_t)(end - start);
+      memcpy(term, start, termLength);
+      term[termLength] = 0;
+      stats_add(main_stats, STATS_DIMENSION_TERMS, term);
+      start += termLength + (end == 0 ? 0 : 1);
+    }
 
-      free(word);
-      start = i + 1;
+    if (main_export != 0) {
+      struct timespec timestamp;
+      clock_gettime(CLOCK_REALTIME, &timestamp);
+
+      export_event_t event;
+      event.timestamp = (uint64_t)timestamp.tv_sec * 1000 + timestamp.tv_nsec / 1000000;
+      event.server = main_irc->hostname;
+      event.channel = target;
+      event.sender = message->sender == 0 ? "" : message->sender;
+      event.occurances = occurances;
+      event.terms = terms;
+      export_add(main_export, &event);
     }
   }
 
-  uint8_t bestMatch = resources_bestMatch(occurances);
+  // Reply once the conversation in the channel crosses the threshold, rather than on every single hit
+  size_t scores[RESOURCES_DATA_SOURCES] = {0};
+  if (!window_add(main_window, target, now, occurances, scores))
+    return;
+
+  uint8_t bestMatch = resources_bestMatch(scores);
 
   switch (bestMatch) {
   case COUNTRY_USA:
-    irc_write(main_irc, "PRIVMSG %s :%s\r\n", main_message->target, "USA is watching 👀");
+    irc_write(main_irc, "PRIVMSG %s :%s\r\n", target, "USA is watching 👀");
     break;
   case COUNTRY_USA_NSA:
-    irc_write(main_irc, "PRIVMSG %s :%s\r\n", main_message->target, "NSA is watching 👀");
+    irc_write(main_irc, "PRIVMSG %s :%s\r\n", target, "NSA is watching 👀");
     break;
   }
 }
 
+void main_traceMessage(irc_message_t *message) {
+  trace_record_t record;
+  memset(&record, 0, sizeof(trace_record_t));
+  strncpy(record.command, message->type, TRACE_MAX_COMMAND_SIZE - 1);
+  record.receivedAt = message->receivedAt;
+  record.readAt = message->readAt;
+  record.parsedAt = message->parsedAt;
+  record.matchedAt = message->matchedAt;
+  // Only writes made while handling this message are replies to it
+  record.repliedAt = main_irc->writtenAt >= message->parsedAt ? main_irc->writtenAt : 0;
+  record.handledAt = trace_now();
+  trace_add(main_trace, &record);
+}
+
 // Handle SIGINT (CTRL + C)
 void main_handleSignalSIGINT(int signalNumber) {
   // Disable handling of SIGCHILD
@@ -135,10 +562,25 @@ void main_handleSignalSIGINT(int signalNumber) {
 
   log(LOG_INFO, "Got SIGINT - exiting cleanly");
 
-  if (main_message != 0)
-    irc_freeMessage(main_message);
+  if (main_irc != 0 && main_message != 0)
+    irc_freeMessage(main_irc, main_message);
   if (main_irc != 0)
     irc_free(main_irc);
+  if (main_cache != 0)
+    cache_free(main_cache);
+  if (main_window != 0)
+    window_free(main_window);
+  if (main_lag != 0)
+    lag_free(main_lag);
+  if (main_stats != 0)
+    stats_free(main_stats);
+  if (main_export != 0)
+    export_free(main_export);
+  if (main_shed != 0)
+    shed_free(main_shed);
+  if (main_trace != 0)
+    trace_free(main_trace);
+  resources_free();
 
   exit(0);
 }
@@ -150,10 +592,25 @@ void main_handleSignalSIGTERM(int signalNumber) {
 
   log(LOG_INFO, "Got SIGTERM - exiting cleanly");
 
-  if (main_message != 0)
-    irc_freeMessage(main_message);
+  if (main_irc != 0 && main_message != 0)
+    irc_freeMessage(main_irc, main_message);
   if (main_irc != 0)
     irc_free(main_irc);
+  if (main_cache != 0)
+    cache_free(main_cache);
+  if (main_window != 0)
+    window_free(main_window);
+  if (main_lag != 0)
+    lag_free(main_lag);
+  if (main_stats != 0)
+    stats_free(main_stats);
+  if (main_export != 0)
+    export_free(main_export);
+  if (main_shed != 0)
+    shed_free(main_shed);
+  if (main_trace != 0)
+    trace_free(main_trace);
+  resources_free();
 
   exit(0);
 }
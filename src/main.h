@@ -1,10 +1,45 @@
 #ifndef MAIN_H
 #define MAIN_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dispatch/dispatch.h"
+#include "irc/irc.h"
+
+#define MAIN_DEFAULT_NICK "watchlist-bot"
+#define MAIN_DEFAULT_PORT 6697
+// Maximum number of seconds to wait between reconnection attempts
+#define MAIN_MAX_RECONNECT_DELAY 300
+// Maximum number of nanoseconds spent handling queued PRIVMSGs before reading from the server again
+#define MAIN_QUEUE_BUDGET 5000000
+
+// Number of heavy hitters per dimension included in the stats reply
+#define MAIN_STATS_TOP_SIZE 3
+
 int main(int argc, const char *argv[]);
 
-void main_handleHelp();
-void main_handleWatchlist();
+void main_reconnect(char *hostname, uint16_t port, char *user, char *nick, char *gecos, char *channel);
+
+// Parse and handle a line read from the server or taken from the queue
+void main_handleLine(irc_line_t *line);
+
+// Handler of an IRC command or numeric, or of a command addressed to the bot, by key (see dispatch_getKey)
+dispatch_handler_t main_findCommand(uint64_t key);
+dispatch_handler_t main_findBotCommand(uint64_t key);
+
+void main_handlePing(irc_message_t *message, const char *arguments);
+void main_handlePong(irc_message_t *message, const char *arguments);
+void main_handlePrivateMessage(irc_message_t *message, const char *arguments);
+
+void main_handleHelp(irc_message_t *message, const char *arguments);
+void main_handleStats(irc_message_t *message, const char *arguments);
+void main_handleLag(irc_message_t *message, const char *arguments);
+void main_handleLoad(irc_message_t *message, const char *arguments);
+void main_handleWatchlist(irc_message_t *message);
+void main_handleMatch(irc_message_t *message, size_t *occurances, const char *terms);
+// Record the stages a handled message passed through in the trace
+void main_traceMessage(irc_message_t *message);
 
 void main_handleSignalSIGINT(int signalNumber);
 void main_handleSignalSIGTERM(int signalNumber);
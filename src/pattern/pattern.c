@@ -0,0 +1,259 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../logging/logging.h"
+
+#include "pattern.h"
+
+#define PATTERN_NO_NODE 0
+#define PATTERN_ROOT 0
+// Longest entry inflections are generated for
+#define PATTERN_MAX_INFLECTED_SIZE 128
+
+static uint32_t pattern_addNode(pattern_t *pattern, uint8_t byte) {
+  if (pattern->nodeCount == pattern->nodeCapacity) {
+    size_t capacity = pattern->nodeCapacity == 0 ? 1024 : pattern->nodeCapacity * 2;
+    pattern_builderNode_t *nodes = realloc(pattern->nodes, sizeof(pattern_builderNode_t) * capacity);
+    if (nodes == 0) {
+      log(LOG_ERROR, "Unable to grow patterns");
+      return PATTERN_NO_NODE;
+    }
+    pattern->nodes = nodes;
+    pattern->nodeCapacity = capacity;
+  }
+
+  pattern_builderNode_t *node = &pattern->nodes[pattern->nodeCount];
+  memset(node, 0, sizeof(pattern_builderNode_t));
+  node->byte = byte;
+  return pattern->nodeCount++;
+}
+
+pattern_t *pattern_create() {
+  pattern_t *pattern = malloc(sizeof(pattern_t));
+  if (pattern == 0) {
+    log(LOG_ERROR, "Unable to allocate patterns");
+    return 0;
+  }
+  memset(pattern, 0, sizeof(pattern_t));
+
+  // The root is never anyone's child, so its index doubles as "no node"
+  pattern_addNode(pattern, 0);
+  if (pattern->nodeCount == 0) {
+    free(pattern);
+    return 0;
+  }
+
+  return pattern;
+}
+
+bool pattern_add(pattern_t *pattern, const char *entry, size_t length, uint32_t sources) {
+  bool wildcard = length > 0 && entry[length - 1] == PATTERN_WILDCARD;
+  if (wildcard)
+    length--;
+
+  // Wildcards are only supported as suffixes, and a lone wildcard would match everything
+  if (length == 0 || memchr(entry, PATTERN_WILDCARD, length) != 0)
+    return false;
+
+  uint32_t current = PATTERN_ROOT;
+  for (size_t i = 0; i < length; i++) {
+    uint8_t byte = entry[i];
+    uint32_t child = pattern->nodes[current].firstChild;
+    while (child != PATTERN_NO_NODE && pattern->nodes[child].byte != byte)
+      child = pattern->nodes[child].nextSibling;
+
+    if (child == PATTERN_NO_NODE) {
+      child = pattern_addNode(pattern, byte);
+      if (child == PATTERN_NO_NODE)
+        return false;
+      pattern->nodes[child].nextSibling = pattern->nodes[current].firstChild;
+      pattern->nodes[current].firstChild = child;
+    }
+    current = child;
+  }
+
+  if (wildcard)
+    pattern->nodes[current].prefix |= sources;
+  else
+    pattern->nodes[current].exact |= sources;
+
+  return true;
+}
+
+static bool pattern_isVowel(char character) {
+  return character == 'a' || character == 'e' || character == 'i' || character == 'o' || character == 'u';
+}
+
+// Add an entry with a suffix, replacing the last few bytes of it
+static bool pattern_addSuffixed(pattern_t *pattern, const char *entry, size_t length, size_t replaced, const char *suffix, uint32_t sources) {
+  char inflected[PATTERN_MAX_INFLECTED_SIZE];
+  size_t suffixLength = strlen(suffix);
+  if (length - replaced + suffixLength > sizeof(inflected))
+    return false;
+
+  memcpy(inflected, entry, length - replaced);
+  memcpy(inflected + length - replaced, suffix, suffixLength);
+  return pattern_add(pattern, inflected, length - replaced + suffixLength, sources);
+}
+
+bool pattern_addInflected(pattern_t *pattern, const char *entry, size_t length, uint32_t sources) {
+  if (!pattern_add(pattern, entry, length, sources))
+    return false;
+
+  // Only inflect plain lowercase words long enough to have a stem (not "us" or "dea")
+  if (length < 4 || entry[length - 1] == PATTERN_WILDCARD)
+    return true;
+  for (size_t i = 0; i < length; i++) {
+    if (entry[i] < 'a' || entry[i] > 'z')
+      return true;
+  }
+
+  char last = entry[length - 1];
+  char beforeLast = entry[length - 2];
+  bool added = true;
+  if (last == 'y' && !pattern_isVowel(beforeLast)) {
+    // "agency" - "agencies"
+    added = added && pattern_addSuffixed(pattern, entry, length, 1, "ies", sources);
+    added = added && pattern_addSuffixed(pattern, entry, length, 1, "ied", sources);
+    added = added && pattern_addSuffixed(pattern, entry, length, 0, "ing", sources);
+  } else if (last == 'e') {
+    // "evacuate" - "evacuates", "evacuated", "evacuating"
+    added = added && pattern_addSuffixed(pattern, entry, length, 0, "s", sources);
+    added = added && pattern_addSuffixed(pattern, entry, length, 0, "d", sources);
+    added = added && pattern_addSuffixed(pattern, entry, length, 1, "ing", sources);
+  } else if (last == 's' || last == 'x' || last == 'z' || (last == 'h' && (beforeLast == 'c' || beforeLast == 's'))) {
+    // "virus" - "viruses", "search" - "searched"
+    added = added && pattern_addSuffixed(pattern, entry, length, 0, "es", sources);
+    added = added && pattern_addSuffixed(pattern, entry, length, 0, "ed", sources);
+    added = added && pattern_addSuffixed(pattern, entry, length, 0, "ing", sources);
+  } else {
+    // "attack" - "attacks", "attacked", "attacking"
+    added = added && pattern_addSuffixed(pattern, entry, length, 0, "s", sources);
+    added = added && pattern_addSuffixed(pattern, entry, length, 0, "ed", sources);
+    added = added && pattern_addSuffixed(pattern, entry, length, 0, "ing", sources);
+  }
+
+  return added;
+}
+
+#define PATTERN_STATE_EXACT 0
+#define PATTERN_STATE_PREFIX 1
+#define PATTERN_STATE_EDGE_COUNT 2
+#define PATTERN_STATE_EDGES 3
+// Number of words used by a state with a number of edges
+#define PATTERN_STATE_SIZE(edgeCount) (PATTERN_STATE_EDGES + ((edgeCount) + 3) / 4 + (edgeCount))
+
+static const pattern_builderNode_t *pattern_sortNodes;
+
+static int pattern_compareBytes(const void *a, const void *b) {
+  return (int)pattern_sortNodes[*(const uint32_t *)a].byte - (int)pattern_sortNodes[*(const uint32_t *)b].byte;
+}
+
+bool pattern_compile(pattern_t *pattern) {
+  size_t nodeCount = pattern->nodeCount;
+  // Nodes in breadth-first order, in which the children of a node are adjacent and sorted by byte
+  uint32_t *order = malloc(sizeof(uint32_t) * nodeCount);
+  uint32_t *firstChild = malloc(sizeof(uint32_t) * nodeCount);
+  uint32_t *childCount = malloc(sizeof(uint32_t) * nodeCount);
+  uint32_t *offsets = malloc(sizeof(uint32_t) * nodeCount);
+  if (order == 0 || firstChild == 0 || childCount == 0 || offsets == 0) {
+    log(LOG_ERROR, "Unable to allocate compiled patterns");
+    free(order);
+    free(firstChild);
+    free(childCount);
+    free(offsets);
+    return false;
+  }
+
+  size_t stateCount = 1;
+  size_t statesSize = 0;
+  order[0] = PATTERN_ROOT;
+  pattern_sortNodes = pattern->nodes;
+  for (size_t state = 0; state < stateCount; state++) {
+    firstChild[state] = stateCount;
+    for (uint32_t child = pattern->nodes[order[state]].firstChild; child != PATTERN_NO_NODE; child = pattern->nodes[child].nextSibling)
+      order[stateCount++] = child;
+    childCount[state] = stateCount - firstChild[state];
+    qsort(order + firstChild[state], childCount[state], sizeof(uint32_t), pattern_compareBytes);
+
+    offsets[state] = statesSize;
+    statesSize += PATTERN_STATE_SIZE(childCount[state]);
+  }
+
+  pattern->states = malloc(sizeof(uint32_t) * statesSize);
+  if (pattern->states == 0) {
+    log(LOG_ERROR, "Unable to allocate compiled patterns");
+    free(order);
+    free(firstChild);
+    free(childCount);
+    free(offsets);
+    return false;
+  }
+  memset(pattern->states, 0, sizeof(uint32_t) * statesSize);
+
+  for (size_t state = 0; state < stateCount; state++) {
+    uint32_t *compiled = pattern->states + offsets[state];
+    const pattern_builderNode_t *node = &pattern->nodes[order[state]];
+    compiled[PATTERN_STATE_EXACT] = node->exact;
+    compiled[PATTERN_STATE_PREFIX] = node->prefix;
+    compiled[PATTERN_STATE_EDGE_COUNT] = childCount[state];
+
+    uint8_t *bytes = (uint8_t *)(compiled + PATTERN_STATE_EDGES);
+    uint32_t *targets = compiled + PATTERN_STATE_EDGES + (childCount[state] + 3) / 4;
+    for (size_t i = 0; i < childCount[state]; i++) {
+      bytes[i] = pattern->nodes[order[firstChild[state] + i]].byte;
+      targets[i] = offsets[firstChild[state] + i];
+    }
+  }
+  pattern->statesSize = statesSize;
+  pattern->stateCount = stateCount;
+
+  free(order);
+  free(firstChild);
+  free(childCount);
+  free(offsets);
+  // The trie is no longer needed
+  free(pattern->nodes);
+  pattern->nodes = 0;
+  pattern->nodeCount = 0;
+  pattern->nodeCapacity = 0;
+
+  log(LOG_DEBUG, "Compiled patterns into %zu states (%zu bytes)", stateCount, statesSize * sizeof(uint32_t));
+  return true;
+}
+
+uint32_t pattern_match(const pattern_t *pattern, const char *word, size_t length) {
+  uint32_t matched = 0;
+  const uint32_t *state = pattern->states;
+  for (size_t i = 0; i < length; i++) {
+    matched |= state[PATTERN_STATE_PREFIX];
+
+    // Binary search for the edge of the next byte
+    uint32_t edgeCount = state[PATTERN_STATE_EDGE_COUNT];
+    const uint8_t *bytes = (const uint8_t *)(state + PATTERN_STATE_EDGES);
+    uint8_t byte = word[i];
+    size_t low = 0;
+    size_t high = edgeCount;
+    while (low < high) {
+      size_t middle = (low + high) / 2;
+      if (bytes[middle] < byte)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+    if (low == edgeCount || bytes[low] != byte)
+      return matched;
+    const uint32_t *targets = state + PATTERN_STATE_EDGES + (edgeCount + 3) / 4;
+    state = pattern->states + targets[low];
+  }
+
+  // Wildcards match the prefix itself too ("attack*" matches "attack")
+  return matched | state[PATTERN_STATE_EXACT] | state[PATTERN_STATE_PREFIX];
+}
+
+void pattern_free(pattern_t *pattern) {
+  free(pattern->nodes);
+  free(pattern->states);
+  free(pattern);
+}
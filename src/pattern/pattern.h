@@ -0,0 +1,52 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Suffix of an entry matching every word it is a prefix of, such as "attack*"
+#define PATTERN_WILDCARD '*'
+
+// A node of the trie being built
+typedef struct {
+  uint32_t firstChild;
+  uint32_t nextSibling;
+  uint8_t byte;
+  // Bit masks of the sources matching words ending at this node, and words continuing past it
+  uint32_t exact;
+  uint32_t prefix;
+} pattern_builderNode_t;
+
+// Entries of all sources compiled into a single deterministic automaton, so that matching a word is a single walk
+// over its bytes regardless of the number of entries
+typedef struct {
+  pattern_builderNode_t *nodes;
+  size_t nodeCount;
+  size_t nodeCapacity;
+
+  // The compiled automaton. Each state is stored together with its edges, so that a step usually touches a
+  // single cache line: exact sources, prefix sources, edge count, edge bytes (sorted, packed four per word)
+  // and the offsets of the edges' target states
+  uint32_t *states;
+  size_t statesSize;
+  size_t stateCount;
+} pattern_t;
+
+pattern_t *pattern_create();
+
+// Add a normalized entry belonging to the sources in a bit mask. Entries ending with PATTERN_WILDCARD match
+// every word starting with the rest of the entry. Returns false if the entry is not a valid pattern
+bool pattern_add(pattern_t *pattern, const char *entry, size_t length, uint32_t sources);
+// Add an English entry along with its regular inflections ("attack" matches "attacks", "attacked" and "attacking")
+bool pattern_addInflected(pattern_t *pattern, const char *entry, size_t length, uint32_t sources);
+
+// Compile the added entries. No entries may be added afterwards
+bool pattern_compile(pattern_t *pattern);
+
+// Bit mask of the sources with an entry matching a word
+uint32_t pattern_match(const pattern_t *pattern, const char *word, size_t length);
+
+void pattern_free(pattern_t *pattern);
+
+#endif
@@ -0,0 +1,43 @@
+// Build-time tool which normalizes resource entries the same way messages are normalized at runtime.
+// Reads entries from stdin, one per line, and writes the normalized entries to stdout
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../unicode/unicode.h"
+
+int main(int argc, const char *argv[]) {
+  char *line = 0;
+  size_t lineSize = 0;
+  ssize_t lineLength = 0;
+  size_t lineNumber = 0;
+  while ((lineLength = getline(&line, &lineSize, stdin)) != -1) {
+    lineNumber++;
+    // Strip trailing LF / CRLF
+    while (lineLength > 0 && (line[lineLength - 1] == '\n' || line[lineLength - 1] == '\r'))
+      line[--lineLength] = 0;
+
+    if (!unicode_isValid(line, lineLength)) {
+      fprintf(stderr, "Invalid UTF-8 on line %zu\n", lineNumber);
+      free(line);
+      return 1;
+    }
+
+    // A trailing wildcard (see pattern_add) is kept rather than trimmed like other punctuation
+    bool wildcard = lineLength > 0 && line[lineLength - 1] == '*';
+    if (wildcard)
+      line[--lineLength] = 0;
+
+    size_t foldedLength = unicode_fold(line, lineLength, line);
+    size_t offset = 0;
+    size_t trimmedLength = unicode_trim(line, foldedLength, &offset);
+    fwrite(line + offset, sizeof(char), trimmedLength, stdout);
+    if (wildcard)
+      fputc('*', stdout);
+    fputc('\n', stdout);
+  }
+
+  free(line);
+  return 0;
+}
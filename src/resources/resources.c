@@ -3,8 +3,53 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "../logging/logging.h"
+#include "../pattern/pattern.h"
+
 #include "resources.h"
 
+// Language of each data source's entries, as named by the source's locale (en_US)
+static const char *resources_sourceLanguages[RESOURCES_DATA_SOURCES] = {"en", "en"};
+// Entries of each data source
+static char **resources_sourceEntries[RESOURCES_DATA_SOURCES] = {RESOURCES_USA_GENERAL_EN_US, RESOURCES_USA_NSA_EN_US};
+
+static pattern_t *resources_patterns = 0;
+
+// Add a list of entries to the patterns, skipping invalid ones
+static void resources_addEntries(char **entries, uint32_t sources, bool stemming) {
+  for (size_t i = 0; entries[i] != 0; i++) {
+    size_t length = strlen(entries[i]);
+    bool added = stemming ? pattern_addInflected(resources_patterns, entries[i], length, sources) : pattern_add(resources_patterns, entries[i], length, sources);
+    if (!added)
+      log(LOG_WARNING, "Ignoring invalid entry '%s'", entries[i]);
+  }
+}
+
+bool resources_initialize(bool stemming) {
+  resources_patterns = pattern_create();
+  if (resources_patterns == 0)
+    return false;
+
+  // Ignored words are never inflected
+  resources_addEntries(RESOURCES_IGNORES, RESOURCES_IGNORED, false);
+  for (size_t i = 0; i < RESOURCES_DATA_SOURCES; i++)
+    resources_addEntries(resources_sourceEntries[i], 1u << i, stemming && strcmp(resources_sourceLanguages[i], "en") == 0);
+
+  if (!pattern_compile(resources_patterns)) {
+    pattern_free(resources_patterns);
+    resources_patterns = 0;
+    return false;
+  }
+
+  return true;
+}
+
+void resources_free() {
+  if (resources_patterns != 0)
+    pattern_free(resources_patterns);
+  resources_patterns = 0;
+}
+
 char *resources_loadFile(const char *filePath) {
   // Open the file in read mode and fail if the path is a directory
   FILE *file = fopen(filePath, "r+");
@@ -41,25 +86,19 @@ char *resources_loadFile(const char *filePath) {
   return buffer;
 }
 
-void resources_countWord(const char *word, size_t *occurances) {
-  for (size_t i = 0; RESOURCES_IGNORES[i] != 0; i++) {
-    if (strcasecmp(word, RESOURCES_IGNORES[i]) == 0)
-      return;
-  }
+bool resources_countWord(const char *word, size_t *occurances) {
+  // All entries are matched in a single walk over the word
+  uint32_t matched = pattern_match(resources_patterns, word, strlen(word));
+  if ((matched & RESOURCES_IGNORED) != 0)
+    return false;
 
-  for (size_t i = 0; RESOURCES_USA_GENERAL_EN_US[i] != 0; i++) {
-    if (strcasecmp(word, RESOURCES_USA_GENERAL_EN_US[i]) == 0) {
-      occurances[0]++;
-      break;
-    }
+  matched &= RESOURCES_ALL_SOURCES;
+  for (size_t i = 0; i < RESOURCES_DATA_SOURCES; i++) {
+    if ((matched & (1u << i)) != 0)
+      occurances[i]++;
   }
 
-  for (size_t i = 0; RESOURCES_USA_NSA_EN_US[i] != 0; i++) {
-    if (strcasecmp(word, RESOURCES_USA_NSA_EN_US[i]) == 0) {
-      occurances[1]++;
-      break;
-    }
-  }
+  return matched != 0;
 }
 
 uint8_t resources_bestMatch(size_t *occurances) {
@@ -79,3 +118,12 @@ uint8_t resources_bestMatch(size_t *occurances) {
 
   return COUNTRY_NO_MATCH;
 }
+
+const char *resources_getSourceName(size_t source) {
+  if (source == 0)
+    return "usa";
+  else if (source == 1)
+    return "usa-nsa";
+
+  return "unknown";
+}
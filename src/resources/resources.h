@@ -9,15 +9,28 @@
 #include "resources/data/ignores.txt.h"
 
 #define RESOURCES_DATA_SOURCES 2
+// Bit mask of every data source
+#define RESOURCES_ALL_SOURCES ((1u << RESOURCES_DATA_SOURCES) - 1)
+// Bit marking ignored words in matches
+#define RESOURCES_IGNORED (1u << 31)
 
 #define COUNTRY_NO_MATCH 0
 #define COUNTRY_USA 1
 #define COUNTRY_USA_NSA 2
 
+// Compile the entries of all data sources into patterns. Entries may end with a wildcard ("attack*").
+// With stemming, English entries also match their regular inflections ("attacks", "attacked")
+bool resources_initialize(bool stemming);
+void resources_free();
+
 // Read a file (does not follow symlinks)
 char *resources_loadFile(const char *filePath) __attribute__((nonnull(1)));
 
-void resources_countWord(const char *word, size_t *occurances);
+// Count a word towards each data source. The word must be normalized (see unicode_fold and unicode_trim),
+// just like the resource entries are at build time. Returns true if the word was counted towards any source
+bool resources_countWord(const char *word, size_t *occurances);
 uint8_t resources_bestMatch(size_t *occurances);
+// Short, stable name of a data source, such as "usa"
+const char *resources_getSourceName(size_t source);
 
 #endif
@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "../hash/hash.h"
+#include "../logging/logging.h"
+
+#include "shed.h"
+
+shed_t *shed_create(uint32_t sampleRate, uint32_t floodRate, uint32_t maxLag) {
+  shed_t *shed = malloc(sizeof(shed_t));
+  if (shed == 0) {
+    log(LOG_ERROR, "Unable to allocate shed queue");
+    return 0;
+  }
+  memset(shed, 0, sizeof(shed_t));
+
+  shed->sampleRate = sampleRate == 0 ? 1 : sampleRate;
+  shed->floodRate = floodRate;
+  shed->maxLag = (uint64_t)maxLag * 1000000;
+
+  return shed;
+}
+
+// When a line arrived, in nanoseconds. Falls back to when it was read if the kernel provided no timestamp
+static uint64_t shed_receivedAt(uint64_t receivedAt, uint64_t readAt) {
+  return receivedAt != 0 ? receivedAt : readAt;
+}
+
+uint64_t shed_getLag(shed_t *shed, const irc_line_t *line, uint64_t now) {
+  // The oldest queued line has waited the longest, otherwise the line just read tells how far behind reading is
+  uint64_t receivedAt = line == 0 ? now : shed_receivedAt(line->receivedAt, line->readAt);
+  if (shed->count > 0)
+    receivedAt = shed_receivedAt(shed->entries[shed->head].receivedAt, shed->entries[shed->head].readAt);
+
+  return now > receivedAt ? now - receivedAt : 0;
+}
+
+bool shed_isOverloaded(shed_t *shed, const irc_line_t *line, uint64_t now) {
+  return shed_getLag(shed, line, now) > shed->maxLag;
+}
+
+// Count a message from a sender, returns true if the sender is above the flood rate
+static bool shed_isFlooding(shed_t *shed, const irc_classification_t *classification, uint32_t now) {
+  uint64_t hash = hash_bytes(classification->sender == 0 ? "" : classification->sender, classification->senderLength, HASH_SEED);
+  shed_sender_t *sender = &shed->senders[hash & (SHED_SENDERS - 1)];
+  if (sender->second != now) {
+    sender->second = now;
+    sender->count = 0;
+  }
+  sender->count++;
+
+  return shed->floodRate > 0 && sender->count > shed->floodRate;
+}
+
+// Count a message in a channel, returns true if it is not part of the sample
+static bool shed_isSampledOut(shed_t *shed, const irc_classification_t *classification) {
+  uint64_t hash = hash_bytes(classification->target, classification->targetLength, HASH_SEED);
+  uint32_t *counter = &shed->channels[hash & (SHED_CHANNELS - 1)];
+  return (*counter)++ % shed->sampleRate != 0;
+}
+
+bool shed_push(shed_t *shed, const irc_line_t *line, const irc_classification_t *classification, uint64_t now) {
+  // Rates are always tracked so that floods are recognized as soon as the bot falls behind
+  bool flooding = shed_isFlooding(shed, classification, (uint32_t)(now / 1000000000));
+  bool sampledOut = shed_isSampledOut(shed, classification);
+
+  if (shed_isOverloaded(shed, line, now)) {
+    if (flooding) {
+      shed->flooded++;
+      return false;
+    }
+    if (sampledOut) {
+      shed->sampledOut++;
+      return false;
+    }
+  }
+
+  if (shed->count == SHED_QUEUE_SIZE) {
+    // Recent messages are more relevant than old ones
+    shed->head = (shed->head + 1) & (SHED_QUEUE_SIZE - 1);
+    shed->count--;
+    shed->droppedOldest++;
+  }
+
+  shed_entry_t *entry = &shed->entries[(shed->head + shed->count) & (SHED_QUEUE_SIZE - 1)];
+  entry->length = line->length < IRC_MESSAGE_MAX_SIZE ? line->length : IRC_MESSAGE_MAX_SIZE - 1;
+  memcpy(entry->line, line->line, entry->length);
+  entry->line[entry->length] = 0;
+  entry->receivedAt = line->receivedAt;
+  entry->readAt = line->readAt;
+  shed->count++;
+  shed->queued++;
+
+  return true;
+}
+
+bool shed_pop(shed_t *shed, irc_line_t *line) {
+  if (shed->count == 0)
+    return false;
+
+  shed_entry_t *entry = &shed->entries[shed->head];
+  line->line = entry->line;
+  line->length = entry->length;
+  line->receivedAt = entry->receivedAt;
+  line->readAt = entry->readAt;
+
+  shed->head = (shed->head + 1) & (SHED_QUEUE_SIZE - 1);
+  shed->count--;
+  shed->handled++;
+
+  return true;
+}
+
+void shed_free(shed_t *shed) {
+  free(shed);
+}
@@ -0,0 +1,76 @@
+#ifndef SHED_H
+#define SHED_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../irc/irc.h"
+
+// Number of PRIVMSGs waiting to be handled at once, must be a power of two
+#define SHED_QUEUE_SIZE 256
+// Queued lines are handled before reading any further once the queue holds this many lines
+#define SHED_HIGH_WATER (SHED_QUEUE_SIZE / 2)
+// Number of channels and senders tracked, must be powers of two. Colliding names share counters
+#define SHED_CHANNELS 256
+#define SHED_SENDERS 1024
+
+// Keep 1 in N of a channel's messages while overloaded
+#define SHED_DEFAULT_SAMPLE_RATE 4
+// Senders sending more messages than this per second are not scanned while overloaded
+#define SHED_DEFAULT_FLOOD_RATE 5
+// Milliseconds the oldest message being handled may lag behind its arrival before the bot is overloaded
+#define SHED_DEFAULT_MAX_LAG 500
+
+typedef struct {
+  char line[IRC_MESSAGE_MAX_SIZE];
+  size_t length;
+  uint64_t receivedAt;
+  uint64_t readAt;
+} shed_entry_t;
+
+typedef struct {
+  uint32_t second;
+  uint32_t count;
+} shed_sender_t;
+
+// A bounded queue of PRIVMSGs which sheds load when messages arrive faster than they are handled
+typedef struct {
+  shed_entry_t entries[SHED_QUEUE_SIZE];
+  size_t head;
+  size_t count;
+
+  // 1 disables sampling
+  uint32_t sampleRate;
+  // 0 disables skipping flooding senders
+  uint32_t floodRate;
+  // In nanoseconds
+  uint64_t maxLag;
+  uint32_t channels[SHED_CHANNELS];
+  shed_sender_t senders[SHED_SENDERS];
+
+  size_t queued;
+  size_t handled;
+  // Lines shed by each policy
+  size_t droppedOldest;
+  size_t sampledOut;
+  size_t flooded;
+} shed_t;
+
+// maxLag is in milliseconds
+shed_t *shed_create(uint32_t sampleRate, uint32_t floodRate, uint32_t maxLag);
+
+// Queue a classified PRIVMSG, dropping the oldest queued line if the queue is full.
+// Returns false if the line was shed instead. now is in nanoseconds since the epoch (see trace_now)
+bool shed_push(shed_t *shed, const irc_line_t *line, const irc_classification_t *classification, uint64_t now);
+// Take the oldest queued line. The line stays valid until the next push. Returns false if the queue is empty
+bool shed_pop(shed_t *shed, irc_line_t *line);
+
+// Nanoseconds the oldest queued line, or a line read at now, has waited since it was received
+uint64_t shed_getLag(shed_t *shed, const irc_line_t *line, uint64_t now);
+// Whether or not lines wait longer than the maximum lag to be handled
+bool shed_isOverloaded(shed_t *shed, const irc_line_t *line, uint64_t now);
+
+void shed_free(shed_t *shed);
+
+#endif
@@ -0,0 +1,174 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../hash/hash.h"
+#include "../logging/logging.h"
+
+#include "stats.h"
+
+stats_t *stats_create(const char *snapshotPath, uint32_t snapshotInterval) {
+  stats_t *stats = malloc(sizeof(stats_t));
+  if (stats == 0) {
+    log(LOG_ERROR, "Unable to allocate statistics");
+    return 0;
+  }
+  memset(stats, 0, sizeof(stats_t));
+
+  stats->data.magic = STATS_SNAPSHOT_MAGIC;
+  stats->data.version = STATS_SNAPSHOT_VERSION;
+  stats->data.seed = HASH_SEED;
+  stats->snapshotInterval = snapshotInterval;
+
+  if (snapshotPath == 0)
+    return stats;
+
+  int file = open(snapshotPath, O_RDWR | O_CREAT, 0644);
+  if (file == -1) {
+    log(LOG_WARNING, "Unable to open statistics snapshot '%s', snapshots are disabled", snapshotPath);
+    return stats;
+  }
+
+  if (ftruncate(file, sizeof(stats_data_t)) == -1) {
+    log(LOG_WARNING, "Unable to size statistics snapshot '%s', snapshots are disabled", snapshotPath);
+    close(file);
+    return stats;
+  }
+
+  void *snapshot = mmap(0, sizeof(stats_data_t), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+  // The mapping stays valid after the file is closed
+  close(file);
+  if (snapshot == MAP_FAILED) {
+    log(LOG_WARNING, "Unable to map statistics snapshot '%s', snapshots are disabled", snapshotPath);
+    return stats;
+  }
+
+  stats->snapshot = snapshot;
+  // Continue from the previous snapshot, if there is a compatible one
+  if (stats->snapshot->magic == STATS_SNAPSHOT_MAGIC && stats->snapshot->version == STATS_SNAPSHOT_VERSION) {
+    log(LOG_INFO, "Restoring statistics from '%s'", snapshotPath);
+    memcpy(&stats->data, stats->snapshot, sizeof(stats_data_t));
+  }
+
+  return stats;
+}
+
+// Column of a key in a row of the sketch, using double hashing to derive a hash per row
+static size_t stats_column(uint64_t hash, size_t row) {
+  uint32_t first = (uint32_t)hash;
+  uint32_t second = (uint32_t)(hash >> 32) | 1;
+  return (first + row * second) & (STATS_SKETCH_WIDTH - 1);
+}
+
+void stats_add(stats_t *stats, uint8_t dimension, const char *key) {
+  stats_dimension_t *data = &stats->data.dimensions[dimension];
+  data->total++;
+
+  uint64_t hash = hash_bytes(key, strlen(key), stats->data.seed);
+  for (size_t row = 0; row < STATS_SKETCH_DEPTH; row++) {
+    uint32_t *counter = &data->sketch[row][stats_column(hash, row)];
+    if (*counter < UINT32_MAX)
+      (*counter)++;
+  }
+
+  // Space-saving: increment the key if tracked, otherwise replace the item with the lowest count
+  stats_item_t *minimum = 0;
+  for (size_t i = 0; i < data->topCount; i++) {
+    stats_item_t *item = &data->top[i];
+    if (strncmp(item->key, key, STATS_MAX_KEY_SIZE - 1) == 0) {
+      item->count++;
+      return;
+    }
+
+    if (minimum == 0 || item->count < minimum->count)
+      minimum = item;
+  }
+
+  stats_item_t *item = 0;
+  if (data->topCount < STATS_TOP_SIZE) {
+    item = &data->top[data->topCount++];
+    item->count = 0;
+  } else {
+    item = minimum;
+  }
+
+  item->error = item->count;
+  item->count++;
+  strncpy(item->key, key, STATS_MAX_KEY_SIZE - 1);
+  item->key[STATS_MAX_KEY_SIZE - 1] = 0;
+}
+
+uint32_t stats_estimate(stats_t *stats, uint8_t dimension, const char *key) {
+  stats_dimension_t *data = &stats->data.dimensions[dimension];
+
+  uint64_t hash = hash_bytes(key, strlen(key), stats->data.seed);
+  uint32_t estimate = UINT32_MAX;
+  for (size_t row = 0; row < STATS_SKETCH_DEPTH; row++) {
+    uint32_t counter = data->sketch[row][stats_column(hash, row)];
+    if (counter < estimate)
+      estimate = counter;
+  }
+
+  return estimate;
+}
+
+static int stats_compareItems(const void *a, const void *b) {
+  const stats_item_t *first = a;
+  const stats_item_t *second = b;
+  if (first->count == second->count)
+    return 0;
+  return first->count > second->count ? -1 : 1;
+}
+
+size_t stats_getTop(stats_t *stats, uint8_t dimension, stats_item_t *items, size_t count) {
+  stats_dimension_t *data = &stats->data.dimensions[dimension];
+
+  stats_item_t sorted[STATS_TOP_SIZE];
+  memcpy(sorted, data->top, sizeof(stats_item_t) * data->topCount);
+  qsort(sorted, data->topCount, sizeof(stats_item_t), stats_compareItems);
+
+  if (count > data->topCount)
+    count = data->topCount;
+  memcpy(items, sorted, sizeof(stats_item_t) * count);
+
+  return count;
+}
+
+void stats_snapshot(stats_t *stats, uint32_t now) {
+  if (stats->snapshot == 0 || now - stats->lastSnapshot < stats->snapshotInterval)
+    return;
+
+  stats->lastSnapshot = now;
+  stats->data.timestamp = (uint64_t)time(NULL);
+  memcpy(stats->snapshot, &stats->data, sizeof(stats_data_t));
+  if (msync(stats->snapshot, sizeof(stats_data_t), MS_ASYNC) == -1)
+    log(LOG_WARNING, "Unable to sync statistics snapshot");
+
+  log(LOG_DEBUG, "Snapshotted statistics");
+}
+
+int stats_getTimeout(stats_t *stats, uint32_t now) {
+  if (stats->snapshot == 0)
+    return -1;
+
+  uint32_t elapsed = now - stats->lastSnapshot;
+  if (elapsed >= stats->snapshotInterval)
+    return 0;
+
+  return (int)(stats->snapshotInterval - elapsed) * 1000;
+}
+
+void stats_free(stats_t *stats) {
+  if (stats->snapshot != 0) {
+    // Always leave the latest statistics behind
+    stats->lastSnapshot = 0;
+    stats->snapshotInterval = 0;
+    stats_snapshot(stats, 0);
+    munmap(stats->snapshot, sizeof(stats_data_t));
+  }
+
+  free(stats);
+}
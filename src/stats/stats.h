@@ -0,0 +1,75 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define STATS_DIMENSION_USERS 0
+#define STATS_DIMENSION_CHANNELS 1
+#define STATS_DIMENSION_TERMS 2
+#define STATS_DIMENSIONS 3
+
+// Count-min sketch size. The estimation error is at most 2 / width of the total with probability 1 - 1 / 2^depth
+#define STATS_SKETCH_DEPTH 4
+// Must be a power of two
+#define STATS_SKETCH_WIDTH 1024
+// Number of heavy hitters tracked by the space-saving algorithm per dimension
+#define STATS_TOP_SIZE 16
+// Keys are truncated to this size (including null-termination) when kept as heavy hitters
+#define STATS_MAX_KEY_SIZE 32
+
+#define STATS_DEFAULT_SNAPSHOT_INTERVAL 60
+#define STATS_SNAPSHOT_MAGIC 0x57424F54
+#define STATS_SNAPSHOT_VERSION 2
+
+typedef struct {
+  char key[STATS_MAX_KEY_SIZE];
+  uint32_t count;
+  // Upper bound of the overestimation of count
+  uint32_t error;
+} stats_item_t;
+
+typedef struct {
+  uint64_t total;
+  uint32_t sketch[STATS_SKETCH_DEPTH][STATS_SKETCH_WIDTH];
+  stats_item_t top[STATS_TOP_SIZE];
+  uint32_t topCount;
+} stats_dimension_t;
+
+// The statistics as laid out in memory and in the snapshot file
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t timestamp;
+  // Seed of the sketch's hashes, kept so that a restored sketch stays valid
+  uint64_t seed;
+  stats_dimension_t dimensions[STATS_DIMENSIONS];
+} stats_data_t;
+
+typedef struct {
+  stats_data_t data;
+
+  // The memory-mapped snapshot file, 0 if snapshots are disabled
+  stats_data_t *snapshot;
+  uint32_t snapshotInterval;
+  uint32_t lastSnapshot;
+} stats_t;
+
+// Create statistics, snapshotting to snapshotPath every snapshotInterval seconds (if snapshotPath is not 0)
+stats_t *stats_create(const char *snapshotPath, uint32_t snapshotInterval);
+
+void stats_add(stats_t *stats, uint8_t dimension, const char *key);
+// Estimate the number of times a key has been added. Never underestimates
+uint32_t stats_estimate(stats_t *stats, uint8_t dimension, const char *key);
+// Get the heavy hitters of a dimension sorted by count, returns the number of items written
+size_t stats_getTop(stats_t *stats, uint8_t dimension, stats_item_t *items, size_t count);
+
+// Copy the statistics to the snapshot file if the interval has passed
+void stats_snapshot(stats_t *stats, uint32_t now);
+// Milliseconds until stats_snapshot needs to be called, -1 if snapshots are disabled
+int stats_getTimeout(stats_t *stats, uint32_t now);
+
+void stats_free(stats_t *stats);
+
+#endif
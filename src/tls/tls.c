@@ -5,8 +5,14 @@
 #include <netinet/in.h>
 #include <poll.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
+#ifdef __linux__
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#endif
+
 #include <openssl/err.h>
 
 #include "../logging/logging.h"
@@ -52,14 +58,21 @@ tls_t *tls_connect(const char *hostname, uint16_t port) {
   }
 
   if (!tls_setNonBlocking(tls)) {
-    free(tls);
+    tls_free(tls);
     return 0;
   }
 
+#ifdef SO_TIMESTAMPING
+  // Have the kernel timestamp received data in software, used to trace the latency of messages
+  int timestamping = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+  if (setsockopt(tls->socketId, SOL_SOCKET, SO_TIMESTAMPING, &timestamping, sizeof(timestamping)) == -1)
+    log(LOG_DEBUG, "Unable to enable receive timestamps, falling back to the time of reading");
+#endif
+
   struct hostent *hostent = gethostbyname(hostname);
   if (hostent == 0) {
     log(LOG_ERROR, "Unable to get host by name for server");
-    free(tls);
+    tls_free(tls);
     return 0;
   }
 
@@ -70,16 +83,17 @@ tls_t *tls_connect(const char *hostname, uint16_t port) {
   socketAddress.sin_family = AF_INET;
   socketAddress.sin_port = htons(port);
 
-  if (connect(tls->socketId, (struct sockaddr *)&socketAddress, sizeof(struct sockaddr_in)) == 0) {
+  // The socket is non-blocking, so the connection is usually still in progress
+  if (connect(tls->socketId, (struct sockaddr *)&socketAddress, sizeof(struct sockaddr_in)) == -1 && errno != EINPROGRESS) {
     log(LOG_ERROR, "Unable to connect to server: %s", strerror(errno));
-    free(tls);
+    tls_free(tls);
     return 0;
   }
 
   tls->ssl = SSL_new(tls_sslContext);
   if (tls->ssl == 0) {
     log(LOG_ERROR, "Unable to instantiate SSL object");
-    free(tls);
+    tls_free(tls);
     return 0;
   }
 
@@ -162,9 +176,69 @@ bool tls_setNonBlocking(tls_t *tls) {
   return true;
 }
 
-char *tls_readLine(tls_t *tls, int timeout, size_t maxBytes) {
-  size_t offset = 0;
+// Mark bytes at the start of the buffer as returned, forgetting the reads which have been fully consumed
+static void tls_consume(tls_t *tls, size_t size) {
+  tls->bufferStart += size;
+  size_t consumed = 0;
+  while (consumed < tls->segmentCount && tls->segments[consumed].end <= tls->bufferStart)
+    consumed++;
+  tls->segmentCount -= consumed;
+  memmove(tls->segments, tls->segments + consumed, sizeof(tls_segment_t) * tls->segmentCount);
+}
+
+char *tls_readLine(tls_t *tls, int timeout, size_t maxBytes, size_t *length) {
+  tls->timedOut = false;
+  if (tls->bufferCapacity < maxBytes + 1) {
+    char *grown = realloc(tls->buffer, sizeof(char) * (maxBytes + 1));
+    if (grown == 0) {
+      log(LOG_ERROR, "Unable to allocate the connection's buffer");
+      return 0;
+    }
+    tls->buffer = grown;
+    tls->bufferCapacity = maxBytes + 1;
+  }
+
   while (true) {
+    // Return the first complete line in the connection's buffer, if any. Several lines may arrive at once
+    char *start = tls->buffer + tls->bufferStart;
+    size_t available = tls->bufferSize - tls->bufferStart;
+    char *newline = available > 0 ? memchr(start, '\n', available) : 0;
+    if (newline != 0 && tls->discarding) {
+      // The end of an overlong line, whose start has already been dropped
+      log(LOG_WARNING, "Dropped the last %zu bytes of an overlong line", (size_t)(newline - start + 1));
+      tls->discarding = false;
+      tls_consume(tls, newline - start + 1);
+      continue;
+    } else if (newline != 0) {
+      size_t lineLength = newline - start;
+      // Strip trailing CRLF
+      if (lineLength > 0 && start[lineLength - 1] == '\r')
+        lineLength--;
+      start[lineLength] = 0;
+      tls->lineTimestamp = tls->segments[0].timestamp;
+
+      tls_consume(tls, newline - start + 1);
+      *length = lineLength;
+      return start;
+    }
+
+    // Make room for the rest of a partial line. The line returned by the previous call is no longer needed
+    if (tls->bufferStart > 0) {
+      memmove(tls->buffer, start, available);
+      for (size_t i = 0; i < tls->segmentCount; i++)
+        tls->segments[i].end -= tls->bufferStart;
+      tls->bufferStart = 0;
+      tls->bufferSize = available;
+    }
+
+    if (tls->bufferSize >= maxBytes) {
+      // Drop the line up to its newline rather than returning its tail as a line of its own
+      log(LOG_WARNING, "No line found without looking for more than max bytes, dropping %zu bytes", tls->bufferSize);
+      tls->bufferSize = 0;
+      tls->segmentCount = 0;
+      tls->discarding = true;
+    }
+
     int pollStatus = tls_pollForData(tls, timeout);
 
     if (pollStatus == TLS_POLL_STATUS_FAILED) {
@@ -174,6 +248,7 @@ char *tls_readLine(tls_t *tls, int timeout, size_t maxBytes) {
 
     if (pollStatus == TLS_POLL_STATUS_NOT_AVAILABLE) {
       log(LOG_DEBUG, "Polling timed out");
+      tls->timedOut = true;
       return 0;
     }
 
@@ -184,56 +259,61 @@ char *tls_readLine(tls_t *tls, int timeout, size_t maxBytes) {
     } else if (bytesAvailable < 0) {
       log(LOG_ERROR, "Unable to get the number of available bytes");
       return 0;
-    } else if ((size_t)bytesAvailable >= maxBytes) {
+    } else if ((size_t)bytesAvailable > maxBytes - tls->bufferSize) {
       // Don't process more than max bytes
-      bytesAvailable = maxBytes;
+      bytesAvailable = maxBytes - tls->bufferSize;
     }
 
-    // Read the request without consuming the content
-    char *buffer = 0;
-    size_t bytesReceived = 0;
-    bytesReceived = tls_read(tls, &buffer, bytesAvailable, READ_FLAGS_NONE);
+    // Read straight into the connection's buffer
+    ssize_t bytesReceived = tls_read(tls, tls->buffer + tls->bufferSize, bytesAvailable, READ_FLAGS_NONE);
     // Reading failed
-    if (buffer == 0)
+    if (bytesReceived < 0)
       return 0;
 
-    // Add the read buffer to the connection's buffer
-    if (tls->buffer == 0) {
-      tls->buffer = buffer;
-    } else {
-      tls->buffer = realloc(tls->buffer, sizeof(char) * (tls->bufferSize + bytesReceived));
-      memcpy(tls->buffer + tls->bufferSize, buffer, bytesReceived);
+    if (bytesReceived > 0) {
       tls->bufferSize += bytesReceived;
-    }
-
-    ssize_t lineLength = -1;
-    for (; offset < bytesReceived; offset++) {
-      if (tls->buffer[offset] == '\n') {
-        lineLength = offset + 1;
-        break;
+      // Remember when the read's data was received, merging it into the previous read if there is no room
+      if (tls->segmentCount < TLS_MAX_SEGMENTS) {
+        tls->segments[tls->segmentCount].timestamp = tls->socketTimestamp;
+        tls->segmentCount++;
       }
+      tls->segments[tls->segmentCount - 1].end = tls->bufferSize;
     }
+  }
+}
 
-    if (lineLength < 1) {
-      if ((size_t)bytesAvailable >= maxBytes) {
-        log(LOG_WARNING, "No line found without looking for more than max bytes");
-        return 0;
-      }
-
-      // There's no line available yet, wait for next event
-      continue;
+// Get the time the kernel received the next unread data on the socket without consuming it.
+// OpenSSL reads the socket itself, so the timestamp is peeked before it gets the chance.
+// Falls back to the current time when kernel timestamps are unavailable
+static uint64_t tls_peekTimestamp(tls_t *tls) {
+#ifdef SO_TIMESTAMPING
+  char data = 0;
+  struct iovec vector = {&data, 1};
+  char control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+  struct msghdr header;
+  memset(&header, 0, sizeof(struct msghdr));
+  header.msg_iov = &vector;
+  header.msg_iovlen = 1;
+  header.msg_control = control;
+  header.msg_controllen = sizeof(control);
+
+  if (recvmsg(tls->socketId, &header, MSG_PEEK | MSG_DONTWAIT) > 0) {
+    for (struct cmsghdr *message = CMSG_FIRSTHDR(&header); message != 0; message = CMSG_NXTHDR(&header, message)) {
+      if (message->cmsg_level != SOL_SOCKET || message->cmsg_type != SO_TIMESTAMPING)
+        continue;
+
+      struct scm_timestamping timestamps;
+      memcpy(&timestamps, CMSG_DATA(message), sizeof(struct scm_timestamping));
+      // The first timestamp is the software one
+      if (timestamps.ts[0].tv_sec != 0)
+        return (uint64_t)timestamps.ts[0].tv_sec * 1000000000 + timestamps.ts[0].tv_nsec;
     }
-
-    // Strip trailing CRLF
-    tls->buffer[bytesReceived - 1] = 0;
-    tls->buffer[bytesReceived - 2] = 0;
-
-    char *result = tls->buffer;
-    tls->buffer = 0;
-    tls->bufferSize = 0;
-
-    return result;
   }
+#endif
+
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
 }
 
 int tls_pollForData(tls_t *tls, int timeout) {
@@ -250,14 +330,17 @@ int tls_pollForData(tls_t *tls, int timeout) {
 
   // Wait for the connection to be ready to read
   int status = poll(descriptors, 1, timeout);
-  if (status < -1) {
+  if (status < 0) {
     log(LOG_ERROR, "Could not wait for connection to send data");
     return TLS_POLL_STATUS_FAILED;
   } else if (status == 0) {
-    log(LOG_ERROR, "The connection timed out");
+    log(LOG_DEBUG, "The connection timed out");
     return TLS_POLL_STATUS_NOT_AVAILABLE;
   }
 
+  // Data which OpenSSL already holds keeps the timestamp of the read that brought it in
+  tls->socketTimestamp = tls_peekTimestamp(tls);
+
   return TLS_POLL_STATUS_AVAILABLE;
 }
 
@@ -272,13 +355,10 @@ ssize_t tls_getAvailableBytes(tls_t *tls) {
     // OpenSSL only returns bytes available for reading. Unless any read has been done,
     // there will be no bytes process for reading. Therefore we need to read at least once
     // before we can use SSL_pending()
-    char *buffer = 0;
+    char buffer = 0;
     // Read one byte without blocking to make OpenSSL process bytes
-    tls_read(tls, &buffer, 1, READ_FLAGS_PEEK);
-    if (buffer == 0)
+    if (tls_read(tls, &buffer, 1, READ_FLAGS_PEEK) < 0)
       return -1;
-    else
-      free(buffer);
   }
 
   log(LOG_DEBUG, "There are %d bytes available for reading from TLS connection", bytesAvailable);
@@ -286,23 +366,25 @@ ssize_t tls_getAvailableBytes(tls_t *tls) {
   return (ssize_t)bytesAvailable;
 }
 
-size_t tls_read(tls_t *tls, char **buffer, size_t bytesToRead, int flags) {
-  (*buffer) = malloc(sizeof(char) * bytesToRead);
+ssize_t tls_read(tls_t *tls, char *buffer, size_t bytesToRead, int flags) {
   size_t bytesReceived = 0;
   int result = 0;
   if (flags == READ_FLAGS_PEEK)
-    result = SSL_peek_ex(tls->ssl, *buffer, bytesToRead, &bytesReceived);
+    result = SSL_peek_ex(tls->ssl, buffer, bytesToRead, &bytesReceived);
   else
-    result = SSL_read_ex(tls->ssl, *buffer, bytesToRead, &bytesReceived);
+    result = SSL_read_ex(tls->ssl, buffer, bytesToRead, &bytesReceived);
 
   if (result != 1) {
     int error = SSL_get_error(tls->ssl, result);
-    if (error == SSL_ERROR_WANT_READ)
+    if (error == SSL_ERROR_WANT_READ) {
       log(LOG_DEBUG, "Could not read from peer. Socket wants read");
-    else if (error == SSL_ERROR_WANT_WRITE)
+    } else if (error == SSL_ERROR_WANT_WRITE) {
       log(LOG_DEBUG, "Could not read from peer. Socket wants write");
-    else
+    } else {
+      // The connection is closed or broken
       log(LOG_DEBUG, "Could not read from peer. Got code %d (%s)", error, ERR_error_string(error, 0));
+      return -1;
+    }
 
     return 0;
   }
@@ -332,6 +414,9 @@ size_t tls_write(tls_t *tls, const char *buffer, size_t bufferSize) {
 }
 
 void tls_disconnect(tls_t *tls) {
+  if (tls->socketId == -1)
+    return;
+
   if (shutdown(tls->socketId, SHUT_RDWR) == -1) {
     if (errno != ENOTCONN && errno != EINVAL) {
       if (errno == ENOTSOCK || errno == EBADF) {
@@ -341,10 +426,12 @@ void tls_disconnect(tls_t *tls) {
         log(LOG_ERROR, "Failed to shutdown TLS connection. Got error %d (%s)", errno, reason);
       }
     }
-  } else {
-    if (close(tls->socketId) == -1)
-      log(LOG_ERROR, "Unable to close TLS connection. Got error %d (%s)", errno, strerror(errno));
   }
+
+  // The socket is closed even if the connection was already shut down, or it would leak
+  if (close(tls->socketId) == -1)
+    log(LOG_ERROR, "Unable to close TLS connection. Got error %d (%s)", errno, strerror(errno));
+  tls->socketId = -1;
 }
 
 void tls_free(tls_t *tls) {
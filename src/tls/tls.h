@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <sys/types.h>
 
 #include <openssl/ssl.h>
 
@@ -16,26 +17,61 @@
 #define TLS_DEFAULT_TLS_1_2_CIPHER_SUITE "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305:DHE-RSA-AES128-GCM-SHA256:DHE-RSA-AES256-GCM-SHA384"
 #define TLS_DEFAULT_TLS_1_3_CIPHER_SUITE "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256"
 
+// Number of reads whose receive timestamps are tracked in the connection's buffer. Further reads are merged into
+// the last one, keeping its (older) timestamp
+#define TLS_MAX_SEGMENTS 16
+
 #define TLS_POLL_STATUS_FAILED -1
 #define TLS_POLL_STATUS_NOT_AVAILABLE 0
 #define TLS_POLL_STATUS_AVAILABLE 1
 
+// Bytes of the connection's buffer that were received by the same read
+typedef struct {
+  // Offset past the segment's last byte
+  size_t end;
+  // When the kernel received the data of the read, in nanoseconds since the epoch
+  uint64_t timestamp;
+} tls_segment_t;
+
 typedef struct {
   int socketId;
   SSL *ssl;
+  // Data read from the connection. Lines are returned in place, so the buffer holds at most one line's worth
+  // of bytes (and a terminator) and is never reallocated once allocated
   char *buffer;
+  size_t bufferCapacity;
+  // Offset of the first byte not yet returned as part of a line
+  size_t bufferStart;
+  // Offset past the last byte read
   size_t bufferSize;
+  // Whether or not the last read timed out
+  bool timedOut;
+  // Whether or not the rest of an overlong line is being dropped, up to and including its newline
+  bool discarding;
+  // When the kernel received the data most recently read from the socket, in nanoseconds since the epoch
+  uint64_t socketTimestamp;
+  // The reads the unconsumed bytes of the buffer came from, oldest first
+  tls_segment_t segments[TLS_MAX_SEGMENTS];
+  size_t segmentCount;
+  // When the kernel received the read containing the first byte of the line last returned by tls_readLine.
+  // Lines which arrived in the same read share a timestamp, so latency is measured per read batch
+  uint64_t lineTimestamp;
 } tls_t;
 
 bool tls_initialize();
 tls_t *tls_connect(const char *hostname, uint16_t port);
 bool tls_setNonBlocking(tls_t *tls);
-size_t tls_read(tls_t *tls, char **buffer, size_t bytesToRead, int flags);
+// Read or peek at most bytesToRead bytes into buffer. Returns the number of bytes read, 0 if the connection
+// wants to be read or written first or -1 if the connection is closed or broken
+ssize_t tls_read(tls_t *tls, char *buffer, size_t bytesToRead, int flags);
 ssize_t tls_getAvailableBytes(tls_t *tls);
 int tls_pollForData(tls_t *tls, int timeout);
 size_t tls_write(tls_t *tls, const char *buffer, size_t bufferSize);
 void tls_disconnect(tls_t *tls);
-char *tls_readLine(tls_t *tls, int timeout, size_t maxBytes);
+// Read a line of at most maxBytes bytes (including the trailing CRLF), without the trailing CRLF. Longer lines are
+// dropped entirely. The line is null-terminated in place in the connection's buffer and is valid until the next call.
+// Returns 0 on failure or timeout (see timedOut)
+char *tls_readLine(tls_t *tls, int timeout, size_t maxBytes, size_t *length);
 void tls_free(tls_t *tls);
 
 #endif
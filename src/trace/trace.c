@@ -0,0 +1,158 @@
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../logging/logging.h"
+
+#include "trace.h"
+
+trace_t *trace_create(const char *path) {
+  trace_t *trace = malloc(sizeof(trace_t));
+  if (trace == 0) {
+    log(LOG_ERROR, "Unable to allocate trace");
+    return 0;
+  }
+  memset(trace, 0, sizeof(trace_t));
+
+  int file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (file == -1) {
+    log(LOG_ERROR, "Unable to open trace '%s'", path);
+    free(trace);
+    return 0;
+  }
+
+  if (ftruncate(file, sizeof(trace_ring_t)) == -1) {
+    log(LOG_ERROR, "Unable to size trace '%s'", path);
+    close(file);
+    free(trace);
+    return 0;
+  }
+
+  void *ring = mmap(0, sizeof(trace_ring_t), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+  // The mapping stays valid after the file is closed
+  close(file);
+  if (ring == MAP_FAILED) {
+    log(LOG_ERROR, "Unable to map trace '%s'", path);
+    free(trace);
+    return 0;
+  }
+
+  trace->ring = ring;
+  trace->ring->magic = TRACE_MAGIC;
+  trace->ring->version = TRACE_VERSION;
+
+  return trace;
+}
+
+void trace_add(trace_t *trace, const trace_record_t *record) {
+  trace_ring_t *ring = trace->ring;
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+  trace_record_t *slot = &ring->records[head & (TRACE_RECORDS - 1)];
+
+  // Mark the record as being written before touching its contents
+  uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  memcpy(slot->command, record->command, TRACE_MAX_COMMAND_SIZE);
+  slot->receivedAt = record->receivedAt;
+  slot->readAt = record->readAt;
+  slot->parsedAt = record->parsedAt;
+  slot->matchedAt = record->matchedAt;
+  slot->repliedAt = record->repliedAt;
+  slot->handledAt = record->handledAt;
+
+  __atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Write a complete event ("X") spanning two timestamps, if both are set
+static void trace_writeEvent(FILE *output, bool *first, const char *name, const char *command, uint64_t start, uint64_t end) {
+  if (start == 0 || end == 0 || end < start)
+    return;
+
+  fprintf(output, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%" PRIu64 ".%03" PRIu64 ",\"dur\":%" PRIu64 ".%03" PRIu64 "}", *first ? "" : ",", name, command, start / 1000, start % 1000, (end - start) / 1000, (end - start) % 1000);
+  *first = false;
+}
+
+bool trace_dump(const char *path, FILE *output) {
+  int file = open(path, O_RDONLY);
+  if (file == -1) {
+    log(LOG_ERROR, "Unable to open trace '%s'", path);
+    return false;
+  }
+
+  // Reading past the end of a mapped file raises SIGBUS, so reject files too small to hold a ring
+  struct stat status;
+  if (fstat(file, &status) == -1 || status.st_size < (off_t)sizeof(trace_ring_t)) {
+    log(LOG_ERROR, "'%s' is not a compatible trace", path);
+    close(file);
+    return false;
+  }
+
+  void *mapping = mmap(0, sizeof(trace_ring_t), PROT_READ, MAP_SHARED, file, 0);
+  close(file);
+  if (mapping == MAP_FAILED) {
+    log(LOG_ERROR, "Unable to map trace '%s'", path);
+    return false;
+  }
+
+  const trace_ring_t *ring = mapping;
+  if (ring->magic != TRACE_MAGIC || ring->version != TRACE_VERSION) {
+    log(LOG_ERROR, "'%s' is not a compatible trace", path);
+    munmap(mapping, sizeof(trace_ring_t));
+    return false;
+  }
+
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  uint64_t start = head > TRACE_RECORDS ? head - TRACE_RECORDS : 0;
+
+  fprintf(output, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  bool first = true;
+  for (uint64_t i = start; i < head; i++) {
+    const trace_record_t *slot = &ring->records[i & (TRACE_RECORDS - 1)];
+
+    // Copy the record, skipping it if the bot is writing it
+    uint32_t before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+    if ((before & 1) != 0)
+      continue;
+    trace_record_t record;
+    memcpy(&record, slot, sizeof(trace_record_t));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != before)
+      continue;
+
+    record.command[TRACE_MAX_COMMAND_SIZE - 1] = 0;
+    for (char *character = record.command; *character != 0; character++) {
+      // Commands are letters or digits, but never trust the file
+      if (*character == '"' || *character == '\\' || (unsigned char)*character < 0x20)
+        *character = '?';
+    }
+
+    trace_writeEvent(output, &first, "message", record.command, record.receivedAt, record.handledAt);
+    trace_writeEvent(output, &first, "receive", record.command, record.receivedAt, record.readAt);
+    trace_writeEvent(output, &first, "parse", record.command, record.readAt, record.parsedAt);
+    trace_writeEvent(output, &first, "match", record.command, record.parsedAt, record.matchedAt);
+    trace_writeEvent(output, &first, "reply", record.command, record.matchedAt != 0 ? record.matchedAt : record.parsedAt, record.repliedAt);
+  }
+  fprintf(output, "\n]}\n");
+
+  munmap(mapping, sizeof(trace_ring_t));
+  return true;
+}
+
+uint64_t trace_now() {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void trace_free(trace_t *trace) {
+  munmap(trace->ring, sizeof(trace_ring_t));
+  free(trace);
+}
@@ -0,0 +1,62 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Number of messages kept in the ring, must be a power of two
+#define TRACE_RECORDS 4096
+#define TRACE_MAX_COMMAND_SIZE 16
+#define TRACE_MAGIC 0x57425452
+#define TRACE_VERSION 1
+
+// Timestamps of a message passing through the bot, in nanoseconds since the epoch (CLOCK_REALTIME,
+// the clock used by the kernel's receive timestamps). Stages that did not happen are 0
+typedef struct {
+  // Odd while the record is being written
+  uint32_t sequence;
+  char command[TRACE_MAX_COMMAND_SIZE];
+  // The kernel received the first byte of the message
+  uint64_t receivedAt;
+  // The line was read from the TLS connection
+  uint64_t readAt;
+  // The line was parsed
+  uint64_t parsedAt;
+  // The message was scanned for watchlist terms
+  uint64_t matchedAt;
+  // The last reply to the message was written
+  uint64_t repliedAt;
+  // The message was completely handled
+  uint64_t handledAt;
+} trace_record_t;
+
+// A ring of records in a memory-mapped file. There is a single writer (the bot), readers in other processes
+// use the per-record sequence numbers to detect and skip records which are being written
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t head;
+  trace_record_t records[TRACE_RECORDS];
+} trace_ring_t;
+
+typedef struct {
+  trace_ring_t *ring;
+} trace_t;
+
+// Create a trace ring in a memory-mapped file
+trace_t *trace_create(const char *path);
+
+// Publish a record to the ring, overwriting the oldest one if the ring is full
+void trace_add(trace_t *trace, const trace_record_t *record);
+
+// Write the records of a trace ring file as Chrome trace event JSON (chrome://tracing, Perfetto)
+bool trace_dump(const char *path, FILE *output);
+
+// Current time in nanoseconds since the epoch
+uint64_t trace_now();
+
+void trace_free(trace_t *trace);
+
+#endif
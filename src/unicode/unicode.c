@@ -0,0 +1,401 @@
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "unicode.h"
+
+#define UNICODE_FOLD_DELTA 0
+#define UNICODE_FOLD_EVEN 1
+#define UNICODE_FOLD_ODD 2
+
+typedef struct {
+  uint32_t start;
+  uint32_t end;
+  uint8_t type;
+  int32_t delta;
+} unicode_foldRange_t;
+
+// Simple case folding (status C and S in CaseFolding.txt) for the scripts we expect in chat.
+// Sorted by start. No folded code point is encoded using more bytes than its source,
+// which is what allows unicode_fold to work in place
+static const unicode_foldRange_t unicode_foldRanges[] = {
+    {0x0041, 0x005A, UNICODE_FOLD_DELTA, 32},
+    {0x00B5, 0x00B5, UNICODE_FOLD_DELTA, 0x03BC - 0x00B5},
+    {0x00C0, 0x00D6, UNICODE_FOLD_DELTA, 32},
+    {0x00D8, 0x00DE, UNICODE_FOLD_DELTA, 32},
+    {0x0100, 0x012F, UNICODE_FOLD_EVEN, 1},
+    {0x0132, 0x0137, UNICODE_FOLD_EVEN, 1},
+    {0x0139, 0x0148, UNICODE_FOLD_ODD, 1},
+    {0x014A, 0x0177, UNICODE_FOLD_EVEN, 1},
+    {0x0178, 0x0178, UNICODE_FOLD_DELTA, 0x00FF - 0x0178},
+    {0x0179, 0x017E, UNICODE_FOLD_ODD, 1},
+    {0x017F, 0x017F, UNICODE_FOLD_DELTA, 0x0073 - 0x017F},
+    {0x0386, 0x0386, UNICODE_FOLD_DELTA, 38},
+    {0x0388, 0x038A, UNICODE_FOLD_DELTA, 37},
+    {0x038C, 0x038C, UNICODE_FOLD_DELTA, 64},
+    {0x038E, 0x038F, UNICODE_FOLD_DELTA, 63},
+    {0x0391, 0x03A1, UNICODE_FOLD_DELTA, 32},
+    {0x03A3, 0x03AB, UNICODE_FOLD_DELTA, 32},
+    {0x03C2, 0x03C2, UNICODE_FOLD_DELTA, 1},
+    {0x0400, 0x040F, UNICODE_FOLD_DELTA, 80},
+    {0x0410, 0x042F, UNICODE_FOLD_DELTA, 32},
+    {0x0460, 0x0481, UNICODE_FOLD_EVEN, 1},
+    {0x048A, 0x04BF, UNICODE_FOLD_EVEN, 1},
+    {0x04C0, 0x04C0, UNICODE_FOLD_DELTA, 15},
+    {0x04C1, 0x04CE, UNICODE_FOLD_ODD, 1},
+    {0x04D0, 0x052F, UNICODE_FOLD_EVEN, 1},
+    {0x0531, 0x0556, UNICODE_FOLD_DELTA, 48},
+    {0x10A0, 0x10C5, UNICODE_FOLD_DELTA, 0x2D00 - 0x10A0},
+    {0x1E00, 0x1E95, UNICODE_FOLD_EVEN, 1},
+    {0x1E9E, 0x1E9E, UNICODE_FOLD_DELTA, 0x00DF - 0x1E9E},
+    {0x1EA0, 0x1EFF, UNICODE_FOLD_EVEN, 1},
+    {0x2126, 0x2126, UNICODE_FOLD_DELTA, 0x03C9 - 0x2126},
+    {0x212A, 0x212A, UNICODE_FOLD_DELTA, 0x006B - 0x212A},
+    {0x212B, 0x212B, UNICODE_FOLD_DELTA, 0x00E5 - 0x212B},
+    {0x2160, 0x216F, UNICODE_FOLD_DELTA, 16},
+    {0x24B6, 0x24CF, UNICODE_FOLD_DELTA, 26},
+    {0xFF21, 0xFF3A, UNICODE_FOLD_DELTA, 32},
+};
+
+#define UNICODE_FOLD_RANGES (sizeof(unicode_foldRanges) / sizeof(unicode_foldRange_t))
+
+// Folded code points of every two byte sequence (U+0080 to U+07FF), indexed by code point - 0x80.
+// Latin, Greek and Cyrillic text is folded without searching the ranges
+static uint16_t unicode_foldTwoBytes[0x800 - 0x80];
+// Bit mask of the three byte sequences' lead bytes (by their low four bits) with code points in any range.
+// Sequences with other lead bytes, such as CJK text, are copied as is
+static uint16_t unicode_foldThreeByteLeads;
+static bool unicode_foldTablesReady = false;
+
+static void unicode_initializeFoldTables() {
+  for (uint32_t codePoint = 0x80; codePoint < 0x800; codePoint++)
+    unicode_foldTwoBytes[codePoint - 0x80] = unicode_foldCodePoint(codePoint);
+
+  for (size_t i = 0; i < UNICODE_FOLD_RANGES; i++) {
+    const unicode_foldRange_t *range = &unicode_foldRanges[i];
+    if (range->end < 0x800 || range->start >= 0x10000)
+      continue;
+    uint32_t start = range->start < 0x800 ? 0x800 : range->start;
+    uint32_t end = range->end >= 0x10000 ? 0xFFFF : range->end;
+    for (uint32_t lead = start >> 12; lead <= end >> 12; lead++)
+      unicode_foldThreeByteLeads |= 1u << lead;
+  }
+
+  unicode_foldTablesReady = true;
+}
+
+// Length of the well-formed sequence starting with a non-ASCII byte, 0 if the sequence is invalid or truncated
+static size_t unicode_sequenceLength(const unsigned char *bytes, size_t available) {
+  unsigned char lead = bytes[0];
+  size_t sequenceLength = 0;
+  // Bounds for the second byte, which rule out overlong forms, surrogates and code points above U+10FFFF
+  unsigned char lower = 0x80;
+  unsigned char upper = 0xBF;
+  if (lead >= 0xC2 && lead <= 0xDF) {
+    sequenceLength = 2;
+  } else if (lead >= 0xE0 && lead <= 0xEF) {
+    sequenceLength = 3;
+    if (lead == 0xE0)
+      lower = 0xA0;
+    else if (lead == 0xED)
+      upper = 0x9F;
+  } else if (lead >= 0xF0 && lead <= 0xF4) {
+    sequenceLength = 4;
+    if (lead == 0xF0)
+      lower = 0x90;
+    else if (lead == 0xF4)
+      upper = 0x8F;
+  } else {
+    return 0;
+  }
+
+  if (sequenceLength > available)
+    return 0;
+  if (bytes[1] < lower || bytes[1] > upper)
+    return 0;
+  for (size_t j = 2; j < sequenceLength; j++) {
+    if ((bytes[j] & 0xC0) != 0x80)
+      return 0;
+  }
+
+  return sequenceLength;
+}
+
+#ifdef __SSE2__
+// Validate a block of UNICODE_VECTOR_SIZE bytes starting at the start of a sequence. Returns the number of bytes
+// validated, which stops short of a sequence continuing past the block, or 0 if the block is invalid
+static size_t unicode_validateBlock(const unsigned char *bytes) {
+  __m128i chunk = _mm_loadu_si128((const __m128i *)bytes);
+  uint32_t high = _mm_movemask_epi8(chunk);
+  if (high == 0)
+    return UNICODE_VECTOR_SIZE;
+
+  // Bytes compare as signed, so 0x80 - 0xBF are the smallest values
+  uint32_t continuations = _mm_movemask_epi8(_mm_cmplt_epi8(chunk, _mm_set1_epi8((char)0xC0)));
+  uint32_t leads = high & ~continuations;
+  uint32_t threeOrMore = _mm_movemask_epi8(_mm_cmpgt_epi8(chunk, _mm_set1_epi8((char)0xDF))) & high;
+  uint32_t four = _mm_movemask_epi8(_mm_cmpgt_epi8(chunk, _mm_set1_epi8((char)0xEF))) & high;
+
+  // C0 and C1 are always overlong, F5 and above are never valid
+  __m128i invalid = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8((char)0xC0)), _mm_cmpeq_epi8(chunk, _mm_set1_epi8((char)0xC1)));
+  invalid = _mm_or_si128(invalid, _mm_and_si128(_mm_cmpgt_epi8(chunk, _mm_set1_epi8((char)0xF4)), _mm_cmplt_epi8(chunk, _mm_setzero_si128())));
+  // E0, ED, F0 and F4 restrict the range of their second byte (overlong forms, surrogates, above U+10FFFF)
+  __m128i previous = _mm_slli_si128(chunk, 1);
+  invalid = _mm_or_si128(invalid, _mm_and_si128(_mm_cmpeq_epi8(previous, _mm_set1_epi8((char)0xE0)), _mm_cmplt_epi8(chunk, _mm_set1_epi8((char)0xA0))));
+  invalid = _mm_or_si128(invalid, _mm_and_si128(_mm_cmpeq_epi8(previous, _mm_set1_epi8((char)0xED)), _mm_cmpgt_epi8(chunk, _mm_set1_epi8((char)0x9F))));
+  invalid = _mm_or_si128(invalid, _mm_and_si128(_mm_cmpeq_epi8(previous, _mm_set1_epi8((char)0xF0)), _mm_cmplt_epi8(chunk, _mm_set1_epi8((char)0x90))));
+  invalid = _mm_or_si128(invalid, _mm_and_si128(_mm_cmpeq_epi8(previous, _mm_set1_epi8((char)0xF4)), _mm_cmpgt_epi8(chunk, _mm_set1_epi8((char)0x8F))));
+  if (_mm_movemask_epi8(invalid) != 0)
+    return 0;
+
+  // Every lead requires continuation bytes right after it, and every continuation byte must be required
+  uint32_t required = (leads << 1) | (threeOrMore << 2) | (four << 3);
+  if ((required & 0xFFFF) != continuations)
+    return 0;
+
+  if ((required >> UNICODE_VECTOR_SIZE) == 0)
+    return UNICODE_VECTOR_SIZE;
+
+  // Stop at the last lead, whose sequence continues in the next block
+  return 31 - __builtin_clz(leads);
+}
+#else
+// Returns the number of leading bytes that are ASCII, checked a word at a time
+static size_t unicode_asciiPrefix(const unsigned char *string, size_t length) {
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+    uint64_t chunk;
+    memcpy(&chunk, string + i, sizeof(uint64_t));
+    if ((chunk & 0x8080808080808080ULL) != 0)
+      break;
+  }
+  while (i < length && string[i] < 0x80)
+    i++;
+  return i;
+}
+#endif
+
+bool unicode_isValid(const char *string, size_t length) {
+  const unsigned char *bytes = (const unsigned char *)string;
+  size_t i = 0;
+  while (i < length) {
+#ifdef __SSE2__
+    // Validate a block at a time throughout the string, falling back to a single sequence when needed
+    if (i + UNICODE_VECTOR_SIZE <= length) {
+      size_t validated = unicode_validateBlock(bytes + i);
+      if (validated > 0) {
+        i += validated;
+        continue;
+      }
+    }
+#else
+    i += unicode_asciiPrefix(bytes + i, length - i);
+    if (i >= length)
+      break;
+#endif
+
+    if (bytes[i] < 0x80) {
+      i++;
+      continue;
+    }
+
+    size_t sequenceLength = unicode_sequenceLength(bytes + i, length - i);
+    if (sequenceLength == 0)
+      return false;
+    i += sequenceLength;
+  }
+
+  return true;
+}
+
+size_t unicode_replaceInvalid(const char *string, size_t length, char *result) {
+  const unsigned char *bytes = (const unsigned char *)string;
+  size_t read = 0;
+  size_t written = 0;
+  while (read < length) {
+    size_t sequenceLength = bytes[read] < 0x80 ? 1 : unicode_sequenceLength(bytes + read, length - read);
+    if (sequenceLength == 0) {
+      written += unicode_encode(UNICODE_REPLACEMENT_CHARACTER, result + written);
+      read++;
+      continue;
+    }
+
+    memcpy(result + written, string + read, sequenceLength);
+    read += sequenceLength;
+    written += sequenceLength;
+  }
+
+  return written;
+}
+
+size_t unicode_decode(const char *string, uint32_t *codePoint) {
+  const unsigned char *bytes = (const unsigned char *)string;
+  if (bytes[0] < 0x80) {
+    *codePoint = bytes[0];
+    return 1;
+  } else if (bytes[0] < 0xE0) {
+    *codePoint = ((uint32_t)(bytes[0] & 0x1F) << 6) | (bytes[1] & 0x3F);
+    return 2;
+  } else if (bytes[0] < 0xF0) {
+    *codePoint = ((uint32_t)(bytes[0] & 0x0F) << 12) | ((uint32_t)(bytes[1] & 0x3F) << 6) | (bytes[2] & 0x3F);
+    return 3;
+  }
+
+  *codePoint = ((uint32_t)(bytes[0] & 0x07) << 18) | ((uint32_t)(bytes[1] & 0x3F) << 12) | ((uint32_t)(bytes[2] & 0x3F) << 6) | (bytes[3] & 0x3F);
+  return 4;
+}
+
+size_t unicode_encode(uint32_t codePoint, char *result) {
+  if (codePoint < 0x80) {
+    result[0] = codePoint;
+    return 1;
+  } else if (codePoint < 0x800) {
+    result[0] = 0xC0 | (codePoint >> 6);
+    result[1] = 0x80 | (codePoint & 0x3F);
+    return 2;
+  } else if (codePoint < 0x10000) {
+    result[0] = 0xE0 | (codePoint >> 12);
+    result[1] = 0x80 | ((codePoint >> 6) & 0x3F);
+    result[2] = 0x80 | (codePoint & 0x3F);
+    return 3;
+  }
+
+  result[0] = 0xF0 | (codePoint >> 18);
+  result[1] = 0x80 | ((codePoint >> 12) & 0x3F);
+  result[2] = 0x80 | ((codePoint >> 6) & 0x3F);
+  result[3] = 0x80 | (codePoint & 0x3F);
+  return 4;
+}
+
+uint32_t unicode_foldCodePoint(uint32_t codePoint) {
+  if (codePoint < 0x80)
+    return codePoint >= 'A' && codePoint <= 'Z' ? codePoint + 32 : codePoint;
+
+  // Binary search for the range containing the code point
+  size_t low = 0;
+  size_t high = UNICODE_FOLD_RANGES;
+  while (low < high) {
+    size_t middle = (low + high) / 2;
+    const unicode_foldRange_t *range = &unicode_foldRanges[middle];
+    if (codePoint < range->start) {
+      high = middle;
+    } else if (codePoint > range->end) {
+      low = middle + 1;
+    } else {
+      if (range->type == UNICODE_FOLD_EVEN && (codePoint & 1) != 0)
+        return codePoint;
+      if (range->type == UNICODE_FOLD_ODD && (codePoint & 1) == 0)
+        return codePoint;
+      return codePoint + range->delta;
+    }
+  }
+
+  return codePoint;
+}
+
+bool unicode_isPunctuation(uint32_t codePoint) {
+  if (codePoint < 0x80)
+    return (codePoint >= '!' && codePoint <= '/') || (codePoint >= ':' && codePoint <= '@') || (codePoint >= '[' && codePoint <= '`') || (codePoint >= '{' && codePoint <= '~');
+
+  // Latin-1 punctuation such as inverted marks and guillemets
+  if (codePoint == 0xA1 || codePoint == 0xA7 || codePoint == 0xAB || codePoint == 0xB6 || codePoint == 0xB7 || codePoint == 0xBB || codePoint == 0xBF)
+    return true;
+  // General punctuation (dashes, quotation marks, ellipsis etc.)
+  if (codePoint >= 0x2010 && codePoint <= 0x2027)
+    return true;
+  if (codePoint >= 0x2030 && codePoint <= 0x205E)
+    return true;
+  // CJK punctuation and brackets
+  if ((codePoint >= 0x3001 && codePoint <= 0x3003) || (codePoint >= 0x3008 && codePoint <= 0x3011))
+    return true;
+
+  return false;
+}
+
+size_t unicode_fold(const char *string, size_t length, char *result) {
+  if (!unicode_foldTablesReady)
+    unicode_initializeFoldTables();
+
+  size_t read = 0;
+  size_t written = 0;
+  while (read < length) {
+    // Fold ASCII a word at a time. A byte's high bit is set by adding 0x3F if it is at least 'A', and by adding
+    // 0x25 if it is above 'Z', which cannot carry into the next byte as long as every byte is ASCII
+    if (read + sizeof(uint64_t) <= length) {
+      uint64_t chunk;
+      memcpy(&chunk, string + read, sizeof(uint64_t));
+      if ((chunk & 0x8080808080808080ULL) == 0) {
+        uint64_t upper = (chunk + 0x3F3F3F3F3F3F3F3FULL) & ~(chunk + 0x2525252525252525ULL) & 0x8080808080808080ULL;
+        chunk |= upper >> 2;
+        memcpy(result + written, &chunk, sizeof(uint64_t));
+        read += sizeof(uint64_t);
+        written += sizeof(uint64_t);
+        continue;
+      }
+    }
+
+    unsigned char current = string[read];
+    if (current < 0x80) {
+      result[written++] = current >= 'A' && current <= 'Z' ? current + 32 : current;
+      read++;
+      continue;
+    }
+
+    if (current < 0xE0) {
+      uint32_t codePoint = unicode_foldTwoBytes[(((uint32_t)(current & 0x1F) << 6) | (string[read + 1] & 0x3F)) - 0x80];
+      read += 2;
+      if (codePoint < 0x80) {
+        result[written++] = codePoint;
+      } else {
+        result[written++] = 0xC0 | (codePoint >> 6);
+        result[written++] = 0x80 | (codePoint & 0x3F);
+      }
+      continue;
+    }
+
+    if (current < 0xF0 && (unicode_foldThreeByteLeads & (1u << (current & 0x0F))) == 0) {
+      // memmove, as result may alias string
+      memmove(result + written, string + read, 3);
+      read += 3;
+      written += 3;
+      continue;
+    }
+
+    uint32_t codePoint = 0;
+    read += unicode_decode(string + read, &codePoint);
+    written += unicode_encode(unicode_foldCodePoint(codePoint), result + written);
+  }
+
+  return written;
+}
+
+size_t unicode_trim(const char *word, size_t length, size_t *offset) {
+  size_t start = 0;
+  size_t end = length;
+
+  while (start < end) {
+    uint32_t codePoint = 0;
+    size_t codePointLength = unicode_decode(word + start, &codePoint);
+    if (!unicode_isPunctuation(codePoint))
+      break;
+    start += codePointLength;
+  }
+
+  while (end > start) {
+    // Step back to the lead byte of the last code point
+    size_t last = end - 1;
+    while (last > start && ((unsigned char)word[last] & 0xC0) == 0x80)
+      last--;
+
+    uint32_t codePoint = 0;
+    unicode_decode(word + last, &codePoint);
+    if (!unicode_isPunctuation(codePoint))
+      break;
+    end = last;
+  }
+
+  *offset = start;
+  return end - start;
+}
@@ -0,0 +1,36 @@
+#ifndef UNICODE_H
+#define UNICODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of bytes validated per step by the vectorized validator
+#define UNICODE_VECTOR_SIZE 16
+
+// Replaces bytes which are not part of well-formed UTF-8
+#define UNICODE_REPLACEMENT_CHARACTER 0xFFFD
+
+// Validate that a string is well-formed UTF-8 (no overlong forms, surrogates or code points above U+10FFFF)
+bool unicode_isValid(const char *string, size_t length);
+// Copy a string, replacing each byte which is not part of a well-formed sequence with U+FFFD.
+// The result must fit 3 * length bytes. Returns the length of the result
+size_t unicode_replaceInvalid(const char *string, size_t length, char *result);
+
+// Decode a single code point from valid UTF-8, returns the number of bytes consumed
+size_t unicode_decode(const char *string, uint32_t *codePoint);
+// Encode a code point as UTF-8, returns the number of bytes written (at most 4)
+size_t unicode_encode(uint32_t codePoint, char *result);
+
+// Apply simple Unicode case folding to a code point
+uint32_t unicode_foldCodePoint(uint32_t codePoint);
+// Whether or not a code point is punctuation that should be stripped from word edges
+bool unicode_isPunctuation(uint32_t codePoint);
+
+// Case fold valid UTF-8. The result is never longer than the input, so result may alias string.
+// Returns the length of the folded string
+size_t unicode_fold(const char *string, size_t length, char *result);
+// Strip punctuation from the edges of a word. Returns the trimmed length and sets offset to the first kept byte
+size_t unicode_trim(const char *word, size_t length, size_t *offset);
+
+#endif
@@ -0,0 +1,168 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../hash/hash.h"
+#include "../logging/logging.h"
+
+#include "window.h"
+
+window_t *window_create(size_t messages, uint32_t duration, uint32_t threshold) {
+  window_t *window = malloc(sizeof(window_t));
+  if (window == 0) {
+    log(LOG_ERROR, "Unable to allocate windows");
+    return 0;
+  }
+  memset(window, 0, sizeof(window_t));
+
+  if (messages == 0 || messages > WINDOW_MAX_MESSAGES) {
+    log(LOG_WARNING, "Window size %zu is out of range, using %d", messages, WINDOW_MAX_MESSAGES);
+    messages = WINDOW_MAX_MESSAGES;
+  }
+
+  window->messages = messages;
+  window->duration = duration;
+  window->threshold = threshold;
+
+  return window;
+}
+
+// Time of a channel's newest message, 0 if it has none
+static uint32_t window_getLastActive(window_channel_t *channel) {
+  if (channel->count == 0)
+    return 0;
+
+  return channel->entries[(channel->head - 1) & (WINDOW_MAX_MESSAGES - 1)].timestamp;
+}
+
+// Remove the channel in a slot, shifting the channels after it back into place so that every channel remains
+// reachable from its home slot without leaving tombstones behind
+static void window_removeChannel(window_t *window, size_t index) {
+  size_t hole = index;
+  for (size_t i = 1; i < WINDOW_MAX_CHANNELS; i++) {
+    size_t next = (index + i) & (WINDOW_MAX_CHANNELS - 1);
+    window_channel_t *channel = &window->channels[next];
+    if (!channel->used)
+      break;
+
+    // A channel may only move back if the hole is not before its home slot
+    size_t home = channel->hash & (WINDOW_MAX_CHANNELS - 1);
+    if (((next - home) & (WINDOW_MAX_CHANNELS - 1)) >= ((next - hole) & (WINDOW_MAX_CHANNELS - 1))) {
+      memcpy(&window->channels[hole], channel, sizeof(window_channel_t));
+      hole = next;
+    }
+  }
+
+  window->channels[hole].used = false;
+  window->channelCount--;
+}
+
+// Drop the least recently active of the channels at and after a home slot (expired channels are the least
+// recently active). Only a few channels are considered, so that making room is cheap
+static void window_evictChannel(window_t *window, uint64_t hash) {
+  size_t victim = WINDOW_MAX_CHANNELS;
+  uint32_t oldest = UINT32_MAX;
+  for (size_t i = 0; i < WINDOW_MAX_CHANNELS && (i < WINDOW_EVICTION_CANDIDATES || victim == WINDOW_MAX_CHANNELS); i++) {
+    size_t index = (hash + i) & (WINDOW_MAX_CHANNELS - 1);
+    window_channel_t *channel = &window->channels[index];
+    if (!channel->used)
+      continue;
+
+    uint32_t lastActive = window_getLastActive(channel);
+    if (victim == WINDOW_MAX_CHANNELS || lastActive < oldest) {
+      victim = index;
+      oldest = lastActive;
+    }
+  }
+
+  if (victim != WINDOW_MAX_CHANNELS) {
+    log(LOG_DEBUG, "Dropping channel '%s' to make room", window->channels[victim].name);
+    window_removeChannel(window, victim);
+  }
+}
+
+static window_channel_t *window_getChannel(window_t *window, const char *name) {
+  size_t nameLength = strlen(name);
+  if (nameLength >= WINDOW_MAX_CHANNEL_NAME_SIZE)
+    return 0;
+
+  uint64_t hash = hash_bytes(name, nameLength, HASH_SEED);
+  for (size_t i = 0; i < WINDOW_MAX_CHANNELS; i++) {
+    window_channel_t *channel = &window->channels[(hash + i) & (WINDOW_MAX_CHANNELS - 1)];
+    if (channel->used && channel->hash == hash && strcmp(channel->name, name) == 0)
+      return channel;
+    if (!channel->used)
+      break;
+  }
+
+  // Keep the load factor at or below 75% to keep probe sequences short
+  if (window->channelCount >= WINDOW_MAX_CHANNELS / 4 * 3)
+    window_evictChannel(window, hash);
+
+  // Channels may have moved while making room, so look for a free slot again
+  for (size_t i = 0; i < WINDOW_MAX_CHANNELS; i++) {
+    window_channel_t *channel = &window->channels[(hash + i) & (WINDOW_MAX_CHANNELS - 1)];
+    if (!channel->used) {
+      memset(channel, 0, sizeof(window_channel_t));
+      channel->used = true;
+      channel->hash = hash;
+      memcpy(channel->name, name, nameLength + 1);
+      window->channelCount++;
+      return channel;
+    }
+  }
+
+  return 0;
+}
+
+// Remove the oldest entry of a channel's window from the sums
+static void window_expireOldest(window_channel_t *channel) {
+  window_entry_t *oldest = &channel->entries[(channel->head - channel->count) & (WINDOW_MAX_MESSAGES - 1)];
+  for (size_t i = 0; i < RESOURCES_DATA_SOURCES; i++)
+    channel->sums[i] -= oldest->occurances[i];
+  channel->count--;
+}
+
+bool window_add(window_t *window, const char *name, uint32_t now, const size_t *occurances, size_t *scores) {
+  window_channel_t *channel = window_getChannel(window, name);
+  if (channel == 0)
+    return false;
+
+  // Expire messages that are too old or that don't fit in the window
+  while (channel->count > 0) {
+    window_entry_t *oldest = &channel->entries[(channel->head - channel->count) & (WINDOW_MAX_MESSAGES - 1)];
+    if (now - oldest->timestamp <= window->duration && channel->count < window->messages)
+      break;
+    window_expireOldest(channel);
+  }
+
+  window_entry_t *entry = &channel->entries[channel->head];
+  channel->head = (channel->head + 1) & (WINDOW_MAX_MESSAGES - 1);
+  channel->count++;
+
+  entry->timestamp = now;
+  bool crossed = false;
+  for (size_t i = 0; i < RESOURCES_DATA_SOURCES; i++) {
+    uint16_t count = occurances[i] > UINT16_MAX ? UINT16_MAX : occurances[i];
+    entry->occurances[i] = count;
+
+    uint32_t previous = channel->sums[i];
+    channel->sums[i] += count;
+    if (previous < window->threshold && channel->sums[i] >= window->threshold)
+      crossed = true;
+
+    scores[i] = channel->sums[i];
+  }
+
+  return crossed;
+}
+
+uint32_t window_now() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint32_t)now.tv_sec;
+}
+
+void window_free(window_t *window) {
+  free(window);
+}
@@ -0,0 +1,62 @@
+#ifndef WINDOW_H
+#define WINDOW_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../resources/resources.h"
+
+// Upper bound of messages kept per channel, must be a power of two
+#define WINDOW_MAX_MESSAGES 64
+// Number of slots for channels, must be a power of two. At most 75% are used at once, after which the least recently
+// active of the WINDOW_EVICTION_CANDIDATES channels following a new channel's slot is dropped to make room
+#define WINDOW_MAX_CHANNELS 512
+#define WINDOW_EVICTION_CANDIDATES 8
+#define WINDOW_MAX_CHANNEL_NAME_SIZE 64
+
+#define WINDOW_DEFAULT_MESSAGES 20
+#define WINDOW_DEFAULT_DURATION 300
+#define WINDOW_DEFAULT_THRESHOLD 3
+
+typedef struct {
+  uint32_t timestamp;
+  uint16_t occurances[RESOURCES_DATA_SOURCES];
+} window_entry_t;
+
+// A channel's ring buffer of recent messages and the running per-source sums over it
+typedef struct {
+  bool used;
+  uint64_t hash;
+  char name[WINDOW_MAX_CHANNEL_NAME_SIZE];
+
+  window_entry_t entries[WINDOW_MAX_MESSAGES];
+  uint16_t head;
+  uint16_t count;
+  uint32_t sums[RESOURCES_DATA_SOURCES];
+} window_channel_t;
+
+typedef struct {
+  window_channel_t channels[WINDOW_MAX_CHANNELS];
+  size_t channelCount;
+
+  // Maximum number of messages in a window
+  size_t messages;
+  // Maximum age of a message in a window, in seconds
+  uint32_t duration;
+  // Score a source must reach within a window to trigger
+  uint32_t threshold;
+} window_t;
+
+window_t *window_create(size_t messages, uint32_t duration, uint32_t threshold);
+
+// Add a message's occurances to a channel's window, expiring old messages. The windowed scores are written
+// to scores. Returns true if any source's score crossed the threshold with this message
+bool window_add(window_t *window, const char *channel, uint32_t now, const size_t *occurances, size_t *scores);
+
+// Monotonic time in seconds
+uint32_t window_now();
+
+void window_free(window_t *window);
+
+#endif
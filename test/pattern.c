@@ -0,0 +1,80 @@
+#include <string.h>
+
+#include "logging/logging.h"
+#include "pattern/pattern.h"
+
+#include "test.h"
+
+// Regular inflections of English entries, and which entries are left alone
+
+#define PATTERN_SOURCE 1
+#define PATTERN_OTHER_SOURCE 2
+
+static void pattern_expect(const pattern_t *pattern, const char *word, uint32_t sources) {
+  uint32_t matched = pattern_match(pattern, word, strlen(word));
+  test_assert(matched == sources, "'%s' matched sources %x, expected %x", word, matched, sources);
+}
+
+int main() {
+  LOGGING_LEVEL = LOG_ERROR;
+
+  pattern_t *pattern = pattern_create();
+  test_assert(pattern != 0, "unable to create pattern");
+  if (pattern == 0)
+    return test_finish("pattern");
+
+  const char *entries[] = {"agency", "delay", "evacuate", "virus", "search", "attack", "dea", "Bomb"};
+  for (size_t i = 0; i < sizeof(entries) / sizeof(entries[0]); i++)
+    test_assert(pattern_addInflected(pattern, entries[i], strlen(entries[i]), PATTERN_SOURCE), "'%s' was rejected", entries[i]);
+  test_assert(pattern_add(pattern, "hack*", 5, PATTERN_OTHER_SOURCE), "'hack*' was rejected");
+  test_assert(!pattern_add(pattern, "*", 1, PATTERN_OTHER_SOURCE), "a lone wildcard was accepted");
+  test_assert(pattern_compile(pattern), "unable to compile pattern");
+
+  // A consonant followed by y becomes "ies" and "ied", but keeps the y before "ing"
+  pattern_expect(pattern, "agency", PATTERN_SOURCE);
+  pattern_expect(pattern, "agencies", PATTERN_SOURCE);
+  pattern_expect(pattern, "agencied", PATTERN_SOURCE);
+  pattern_expect(pattern, "agencying", PATTERN_SOURCE);
+  pattern_expect(pattern, "agencys", 0);
+  pattern_expect(pattern, "agencyed", 0);
+  pattern_expect(pattern, "agenciing", 0);
+
+  // A vowel followed by y is inflected regularly
+  pattern_expect(pattern, "delays", PATTERN_SOURCE);
+  pattern_expect(pattern, "delayed", PATTERN_SOURCE);
+  pattern_expect(pattern, "delaying", PATTERN_SOURCE);
+  pattern_expect(pattern, "delaies", 0);
+
+  // A trailing e is dropped before "ing" and not doubled before "d"
+  pattern_expect(pattern, "evacuates", PATTERN_SOURCE);
+  pattern_expect(pattern, "evacuated", PATTERN_SOURCE);
+  pattern_expect(pattern, "evacuating", PATTERN_SOURCE);
+  pattern_expect(pattern, "evacuateing", 0);
+  pattern_expect(pattern, "evacuateed", 0);
+
+  // Sibilants take "es"
+  pattern_expect(pattern, "viruses", PATTERN_SOURCE);
+  pattern_expect(pattern, "virusing", PATTERN_SOURCE);
+  pattern_expect(pattern, "viruss", 0);
+  pattern_expect(pattern, "searches", PATTERN_SOURCE);
+  pattern_expect(pattern, "searched", PATTERN_SOURCE);
+
+  pattern_expect(pattern, "attacks", PATTERN_SOURCE);
+  pattern_expect(pattern, "attacked", PATTERN_SOURCE);
+  pattern_expect(pattern, "attacking", PATTERN_SOURCE);
+  pattern_expect(pattern, "attacker", 0);
+
+  // Short and non-lowercase entries only match themselves
+  pattern_expect(pattern, "dea", PATTERN_SOURCE);
+  pattern_expect(pattern, "deas", 0);
+  pattern_expect(pattern, "Bomb", PATTERN_SOURCE);
+  pattern_expect(pattern, "Bombs", 0);
+
+  // Wildcards match every continuation, including none
+  pattern_expect(pattern, "hack", PATTERN_OTHER_SOURCE);
+  pattern_expect(pattern, "hacker", PATTERN_OTHER_SOURCE);
+  pattern_expect(pattern, "hac", 0);
+
+  pattern_free(pattern);
+  return test_finish("pattern");
+}
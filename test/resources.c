@@ -0,0 +1,46 @@
+#include <string.h>
+
+#include "logging/logging.h"
+#include "resources/resources.h"
+
+#include "test.h"
+
+// Every single-word entry of a source must be counted towards that source, and ignored words towards none
+
+int main() {
+  LOGGING_LEVEL = LOG_ERROR;
+  test_assert(resources_initialize(false), "unable to initialize resources");
+
+  size_t termCount = 0;
+  size_t missed = 0;
+  char **entries[RESOURCES_DATA_SOURCES] = {RESOURCES_USA_GENERAL_EN_US, RESOURCES_USA_NSA_EN_US};
+  for (size_t source = 0; source < RESOURCES_DATA_SOURCES; source++) {
+    for (size_t i = 0; entries[source][i] != 0; i++) {
+      const char *entry = entries[source][i];
+      if (entry[0] == 0 || strpbrk(entry, " *") != 0)
+        continue;
+      // Entries which are also ignored are never counted
+      bool ignored = false;
+      for (size_t j = 0; RESOURCES_IGNORES[j] != 0 && !ignored; j++)
+        ignored = strcmp(entry, RESOURCES_IGNORES[j]) == 0;
+      if (ignored)
+        continue;
+
+      size_t occurances[RESOURCES_DATA_SOURCES] = {0};
+      bool counted = resources_countWord(entry, occurances) && occurances[source] == 1;
+      termCount++;
+      if (!counted && missed++ < 10)
+        test_assert(counted, "'%s' was not counted towards '%s'", entry, resources_getSourceName(source));
+    }
+  }
+  test_assert(termCount > 100, "only %zu terms found", termCount);
+  test_assert(missed == 0, "%zu terms were not counted", missed);
+
+  for (size_t i = 0; RESOURCES_IGNORES[i] != 0; i++) {
+    size_t occurances[RESOURCES_DATA_SOURCES] = {0};
+    test_assert(!resources_countWord(RESOURCES_IGNORES[i], occurances), "ignored word '%s' was counted", RESOURCES_IGNORES[i]);
+  }
+
+  resources_free();
+  return test_finish("resources");
+}
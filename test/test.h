@@ -0,0 +1,23 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+
+// Assertions shared by the tests in test/. Each test is a program which returns non-zero if any assertion failed
+static int test_failures = 0;
+
+#define test_assert(condition, ...)                   \
+  do {                                                \
+    if (!(condition)) {                               \
+      fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); \
+      fprintf(stderr, __VA_ARGS__);                   \
+      fprintf(stderr, "\n");                          \
+      test_failures++;                                \
+    }                                                 \
+  } while (0)
+
+// Print a summary and return the exit code of the test
+#define test_finish(name)                                                     \
+  (test_failures == 0 ? (printf("%s: passed\n", name), 0) : (printf("%s: %d failed\n", name, test_failures), 1))
+
+#endif